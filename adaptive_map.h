@@ -0,0 +1,589 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "unordered_map.h"
+
+
+// Map that picks its layout from its size and access pattern:
+//  - kLinear: at most kLinearMax pairs in an unsorted array, found by a scan;
+//  - kChained: the UnorderedMap engine;
+//  - kFlat: linear probing over (hash, pointer) slots, for maps of at least
+//    kFlatMin elements that see kReadRatio lookups per mutation.
+// Pairs are allocated once and only pointers move between layouts, so
+// references stay valid until their element is erased. Iterators are
+// invalidated by inserts, by erase(key) and by non-const lookups (find, at,
+// operator[]), which are the only calls that change the layout, so a map
+// that is loaded once and then only read still goes flat. Const lookups and
+// erase(iterator) never do, so erase-while-iterating works. The
+// chained/flat decision is taken once per window of
+// max(size, kMinWindow) operations, which amortizes each O(n) migration
+// over at least n operations. Lookups update counters, so unlike
+// UnorderedMap concurrent const lookups need external synchronization.
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>,
+    typename Allocator = std::allocator<std::pair<const Key, Value>>
+>
+class AdaptiveUnorderedMap {
+public:
+  enum class Layout {
+    kLinear,
+    kChained,
+    kFlat,
+  };
+
+  static constexpr size_t kLinearMax = 8;
+  static constexpr size_t kFlatMin = 1024;
+  static constexpr size_t kMinWindow = 64;
+  static constexpr size_t kReadRatio = 8;
+  static constexpr size_t kWriteRatio = 2;
+  static constexpr size_t kMaxProbe = 64;
+
+  using NodeType = std::pair<const Key, Value>;
+  using AllocatorTraits = std::allocator_traits<Allocator>;
+  using Chained = UnorderedMap<Key, Value, Hash, Equal, Allocator>;
+  using NodeArray =
+  std::vector<NodeType*, typename AllocatorTraits::template rebind_alloc<NodeType*>>;
+
+  struct Slot {
+    size_t hash;
+    NodeType* node;
+  };
+
+  using SlotArray = std::vector<Slot, typename AllocatorTraits::template rebind_alloc<Slot>>;
+
+  template<bool IsConst>
+  class iterator_impl {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<IsConst, const NodeType*, NodeType*>;
+    using reference = std::conditional_t<IsConst, const NodeType&, NodeType&>;
+    using chained_iterator = typename Chained::iterator;
+
+    const AdaptiveUnorderedMap* owner;
+    size_t index;
+    std::optional<chained_iterator> node;
+
+    iterator_impl(const AdaptiveUnorderedMap* owner, size_t index):
+        owner(owner), index(index) {
+      skip_empty();
+    }
+
+    iterator_impl(const AdaptiveUnorderedMap* owner, chained_iterator node):
+        owner(owner), index(0), node(node) {}
+
+    void skip_empty() {
+      if (owner->current_layout == Layout::kFlat) {
+        while (index < owner->slots.size() && owner->slots[index].node == nullptr) {
+          ++index;
+        }
+      }
+    }
+
+    operator iterator_impl<true>() const {
+      return node ? iterator_impl<true>(owner, *node) : iterator_impl<true>(owner, index);
+    }
+
+    NodeType* get() const {
+      switch (owner->current_layout) {
+        case Layout::kLinear:
+          return owner->linear[index];
+        case Layout::kFlat:
+          return owner->slots[index].node;
+        default:
+          return &**node;
+      }
+    }
+
+    reference operator*() const {
+      return *get();
+    }
+
+    pointer operator->() const {
+      return get();
+    }
+
+    iterator_impl& operator++() {
+      if (node) {
+        ++*node;
+      } else {
+        ++index;
+        skip_empty();
+      }
+      return *this;
+    }
+
+    iterator_impl operator++(int) {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const iterator_impl& other) const {
+      return index == other.index && node == other.node;
+    }
+
+    bool operator!=(const iterator_impl& other) const {
+      return !(*this == other);
+    }
+  };
+
+  using iterator = iterator_impl<false>;
+  using const_iterator = iterator_impl<true>;
+
+  Layout current_layout = Layout::kLinear;
+  Hash hash_function;
+  Equal equal_key;
+  Allocator t_alloc;
+  NodeArray linear;
+  Chained chained;
+  SlotArray slots;
+  size_t flat_size = 0;
+  size_t flat_shift = 0;
+
+  mutable size_t lookups = 0;
+  size_t mutations = 0;
+  size_t transitions = 0;
+
+  AdaptiveUnorderedMap(): AdaptiveUnorderedMap(Allocator()) {}
+
+  explicit AdaptiveUnorderedMap(
+      const Allocator& alloc,
+      const Hash& hash = Hash(),
+      const Equal& equal = Equal()):
+      hash_function(hash),
+      equal_key(equal),
+      t_alloc(alloc),
+      linear(alloc),
+      chained(1, hash, equal, alloc),
+      slots(alloc) {}
+
+  AdaptiveUnorderedMap(const AdaptiveUnorderedMap& other):
+      AdaptiveUnorderedMap(
+          AllocatorTraits::select_on_container_copy_construction(other.t_alloc),
+          other.hash_function, other.equal_key) {
+    for (const NodeType& item : other) {
+      emplace(item);
+    }
+  }
+
+  AdaptiveUnorderedMap(AdaptiveUnorderedMap&& other):
+      current_layout(other.current_layout),
+      hash_function(std::move(other.hash_function)),
+      equal_key(std::move(other.equal_key)),
+      t_alloc(other.t_alloc),
+      linear(std::move(other.linear)),
+      chained(std::move(other.chained)),
+      slots(std::move(other.slots)),
+      flat_size(other.flat_size),
+      flat_shift(other.flat_shift),
+      lookups(other.lookups),
+      mutations(other.mutations),
+      transitions(other.transitions) {
+    other.current_layout = Layout::kLinear;
+    other.linear.clear();
+    other.slots.clear();
+    other.flat_size = 0;
+  }
+
+  AdaptiveUnorderedMap& operator=(const AdaptiveUnorderedMap&) = delete;
+  AdaptiveUnorderedMap& operator=(AdaptiveUnorderedMap&&) = delete;
+
+  ~AdaptiveUnorderedMap() {
+    destroy_nodes();
+  }
+
+  Layout layout() const {
+    return current_layout;
+  }
+
+  size_t size() const {
+    switch (current_layout) {
+      case Layout::kLinear:
+        return linear.size();
+      case Layout::kChained:
+        return chained.size();
+      default:
+        return flat_size;
+    }
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  void destroy_nodes() {
+    NodeArray nodes = take_all();
+    for (NodeType* node : nodes) {
+      AllocatorTraits::destroy(t_alloc, node);
+      AllocatorTraits::deallocate(t_alloc, node, 1);
+    }
+  }
+
+  void clear() {
+    destroy_nodes();
+    current_layout = Layout::kLinear;
+    lookups = mutations = 0;
+  }
+
+  size_t flat_capacity() const {
+    return slots.size() - kMaxProbe;
+  }
+
+  // Fibonacci hashing: the top bits of the product, so identity hashes of
+  // sequential keys do not form one long probe run.
+  size_t flat_index(size_t hash) const {
+    return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ULL) >> flat_shift);
+  }
+
+  size_t flat_find(const Key& key, size_t hash) const {
+    for (size_t i = flat_index(hash); i < slots.size() && slots[i].node != nullptr; ++i) {
+      if (slots[i].hash == hash && equal_key(slots[i].node->first, key)) {
+        return i;
+      }
+    }
+    return slots.size();
+  }
+
+  // Probes never wrap around; the kMaxProbe slots past the last home keep
+  // them in bounds. A longer run returns slots.size(): the hash clusters and
+  // the caller gives up on the flat layout.
+  size_t flat_link(size_t hash, NodeType* node) {
+    size_t home = flat_index(hash);
+    for (size_t i = home; i < home + kMaxProbe; ++i) {
+      if (slots[i].node == nullptr) {
+        slots[i] = Slot{hash, node};
+        ++flat_size;
+        return i;
+      }
+    }
+    return slots.size();
+  }
+
+  // Backward-shift deletion. Entries only ever move to lower indices, so an
+  // iterator positioned at `hole` still visits every remaining element.
+  void flat_unlink(size_t hole) {
+    for (size_t i = hole + 1; i < slots.size() && slots[i].node != nullptr; ++i) {
+      if (flat_index(slots[i].hash) <= hole) {
+        slots[hole] = slots[i];
+        hole = i;
+      }
+    }
+    slots[hole] = Slot{0, nullptr};
+    --flat_size;
+  }
+
+  bool flat_build(const NodeArray& nodes, size_t count) {
+    size_t bits = 4;
+    while ((size_t(1) << bits) < count * 2) {
+      ++bits;
+    }
+    flat_shift = 64 - bits;
+    slots.assign((size_t(1) << bits) + kMaxProbe, Slot{0, nullptr});
+    flat_size = 0;
+    for (NodeType* node : nodes) {
+      if (flat_link(hash_function(node->first), node) == slots.size()) {
+        slots.clear();
+        flat_size = 0;
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Empties the current layout and returns its pairs.
+  NodeArray take_all() {
+    NodeArray nodes(t_alloc);
+    switch (current_layout) {
+      case Layout::kLinear:
+        nodes.swap(linear);
+        break;
+      case Layout::kChained:
+        nodes.reserve(chained.size());
+        chained.release([&](NodeType* node) { nodes.push_back(node); });
+        break;
+      case Layout::kFlat:
+        nodes.reserve(flat_size);
+        for (const Slot& slot : slots) {
+          if (slot.node != nullptr) {
+            nodes.push_back(slot.node);
+          }
+        }
+        slots.clear();
+        slots.shrink_to_fit();
+        flat_size = 0;
+        break;
+    }
+    return nodes;
+  }
+
+  // Moves every pair into `target`, sized for `count` elements. A flat table
+  // that cannot place every pair within kMaxProbe of its home falls back to
+  // chained. The chained table is grown before any pair is detached; if a
+  // later step throws, the pairs are parked in the linear array, which needs
+  // no allocation, and the next adapt() moves them on.
+  void migrate(Layout target, size_t count) {
+    Layout source = current_layout;
+    if (target != Layout::kLinear && source != Layout::kChained) {
+      chained.reserve(count);
+    }
+    NodeArray nodes = take_all();
+    try {
+      if (target == Layout::kFlat && !flat_build(nodes, count)) {
+        target = Layout::kChained;
+      }
+      current_layout = target;
+      if (target == Layout::kLinear) {
+        linear.swap(nodes);
+        linear.reserve(kLinearMax);
+      } else if (target == Layout::kChained) {
+        chained.reserve(count);
+        for (NodeType* node : nodes) {
+          chained.adopt(node);
+        }
+      }
+    } catch (...) {
+      if (target != Layout::kLinear) {
+        chained.release([](NodeType*) {});
+        slots.clear();
+        flat_size = 0;
+        linear.swap(nodes);
+      }
+      current_layout = Layout::kLinear;
+      throw;
+    }
+    if (target != source) {
+      ++transitions;
+    }
+    if (source == Layout::kChained && target != Layout::kChained) {
+      // Returning the bucket array is best effort; an empty table is valid.
+      try {
+        chained.rehash(1);
+      } catch (...) {
+      }
+    }
+  }
+
+  // The only place the layout changes; `count` is the size the calling
+  // operation is about to leave behind.
+  void adapt(size_t count) {
+    if (current_layout == Layout::kLinear) {
+      if (count > kLinearMax) {
+        migrate(Layout::kChained, count);
+      }
+      return;
+    }
+    if (count <= kLinearMax / 2) {
+      migrate(Layout::kLinear, count);
+      return;
+    }
+    if (lookups + mutations < std::max(size(), kMinWindow)) {
+      return;
+    }
+    if (current_layout == Layout::kChained &&
+        count >= kFlatMin && lookups >= kReadRatio * mutations) {
+      migrate(Layout::kFlat, count);
+    } else if (current_layout == Layout::kFlat &&
+        (count < kFlatMin / 2 || lookups < kWriteRatio * mutations)) {
+      migrate(Layout::kChained, count);
+    }
+    lookups = mutations = 0;
+  }
+
+  size_t linear_find(const Key& key) const {
+    size_t i = 0;
+    while (i < linear.size() && !equal_key(linear[i]->first, key)) {
+      ++i;
+    }
+    return i;
+  }
+
+  iterator locate(const Key& key) {
+    switch (current_layout) {
+      case Layout::kLinear:
+        return iterator(this, linear_find(key));
+      case Layout::kChained:
+        return iterator(this, chained.find(key));
+      default:
+        return iterator(this, flat_find(key, hash_function(key)));
+    }
+  }
+
+  // Links a pair allocated through t_alloc. The map owns it unless the key
+  // is already present, in which case the caller keeps it.
+  std::pair<iterator, bool> adopt(NodeType* node) {
+    ++mutations;
+    iterator found = locate(node->first);
+    if (found != end()) {
+      return {found, false};
+    }
+    adapt(size() + 1);
+    if (current_layout == Layout::kLinear) {
+      linear.push_back(node);
+      return {iterator(this, linear.size() - 1), true};
+    }
+    if (current_layout == Layout::kFlat) {
+      if ((flat_size + 1) * 2 > flat_capacity()) {
+        migrate(Layout::kFlat, flat_size + 1);
+      }
+      if (current_layout == Layout::kFlat) {
+        size_t index = flat_link(hash_function(node->first), node);
+        if (index != slots.size()) {
+          return {iterator(this, index), true};
+        }
+        migrate(Layout::kChained, size() + 1);
+      }
+    }
+    return {iterator(this, chained.adopt(node).first), true};
+  }
+
+  template<class... Args>
+  std::pair<iterator, bool> emplace(Args&&... args) {
+    NodeType* node = AllocatorTraits::allocate(t_alloc, 1);
+    AllocatorTraits::construct(t_alloc, node, std::forward<Args>(args)...);
+    std::pair<iterator, bool> result{end(), false};
+    try {
+      result = adopt(node);
+    } catch (...) {
+      AllocatorTraits::destroy(t_alloc, node);
+      AllocatorTraits::deallocate(t_alloc, node, 1);
+      throw;
+    }
+    if (!result.second) {
+      AllocatorTraits::destroy(t_alloc, node);
+      AllocatorTraits::deallocate(t_alloc, node, 1);
+    }
+    return result;
+  }
+
+  std::pair<iterator, bool> insert(const NodeType& value) {
+    return emplace(value);
+  }
+
+  std::pair<iterator, bool> insert(NodeType&& value) {
+    return emplace(std::move(value));
+  }
+
+  // A lookup never fails for lack of memory: if the migration throws, the
+  // pairs stay reachable and the next window tries again.
+  iterator find(const Key& key) {
+    if (++lookups + mutations >= std::max(size(), kMinWindow)) {
+      try {
+        adapt(size());
+      } catch (const std::bad_alloc&) {
+      }
+    }
+    return locate(key);
+  }
+
+  const_iterator find(const Key& key) const {
+    ++lookups;
+    return const_cast<AdaptiveUnorderedMap*>(this)->locate(key);
+  }
+
+  bool contains(const Key& key) const {
+    return find(key) != end();
+  }
+
+  size_t count(const Key& key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  Value& at(const Key& key) {
+    iterator it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("Target element doesn't exists");
+    }
+    return it->second;
+  }
+
+  const Value& at(const Key& key) const {
+    const_iterator it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("Target element doesn't exists");
+    }
+    return it->second;
+  }
+
+  Value& operator[](const Key& key) {
+    iterator it = find(key);
+    if (it != end()) {
+      return it->second;
+    }
+    return emplace(std::piecewise_construct, std::forward_as_tuple(key), std::tuple<>())
+        .first->second;
+  }
+
+  iterator erase(const_iterator it) {
+    ++mutations;
+    if (current_layout == Layout::kChained) {
+      typename Chained::iterator position = *it.node;
+      return iterator(this, chained.erase(position));
+    }
+    NodeType* node = it.get();
+    if (current_layout == Layout::kLinear) {
+      linear[it.index] = linear.back();
+      linear.pop_back();
+    } else {
+      flat_unlink(it.index);
+    }
+    AllocatorTraits::destroy(t_alloc, node);
+    AllocatorTraits::deallocate(t_alloc, node, 1);
+    return iterator(this, it.index);
+  }
+
+  size_t erase(const Key& key) {
+    iterator it = locate(key);
+    if (it == end()) {
+      return 0;
+    }
+    erase(it);
+    adapt(size());
+    return 1;
+  }
+
+  iterator begin() {
+    if (current_layout == Layout::kChained) {
+      return iterator(this, chained.begin());
+    }
+    return iterator(this, 0);
+  }
+
+  iterator end() {
+    switch (current_layout) {
+      case Layout::kLinear:
+        return iterator(this, linear.size());
+      case Layout::kChained:
+        return iterator(this, chained.end());
+      default:
+        return iterator(this, slots.size());
+    }
+  }
+
+  const_iterator begin() const {
+    return const_cast<AdaptiveUnorderedMap*>(this)->begin();
+  }
+
+  const_iterator end() const {
+    return const_cast<AdaptiveUnorderedMap*>(this)->end();
+  }
+
+  const_iterator cbegin() const {
+    return begin();
+  }
+
+  const_iterator cend() const {
+    return end();
+  }
+};
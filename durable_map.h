@@ -0,0 +1,376 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "fast_hash.h"
+#include "unordered_map.h"
+
+
+template<typename T, typename = void>
+struct JournalCodec;
+
+template<typename T>
+struct JournalCodec<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+  static void encode(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  static bool decode(const char*& p, const char* end, T& value) {
+    if (static_cast<size_t>(end - p) < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+  }
+};
+
+template<>
+struct JournalCodec<std::string> {
+  static void encode(std::string& out, const std::string& value) {
+    JournalCodec<uint64_t>::encode(out, value.size());
+    out.append(value);
+  }
+
+  static bool decode(const char*& p, const char* end, std::string& value) {
+    uint64_t length;
+    if (!JournalCodec<uint64_t>::decode(p, end, length) ||
+        static_cast<uint64_t>(end - p) < length) {
+      return false;
+    }
+    value.assign(p, length);
+    p += length;
+    return true;
+  }
+};
+
+// In-memory UnorderedMap whose mutations are appended to a log before they
+// return. Concurrent writers share one write + fdatasync: whoever finds no
+// flush in progress writes every pending record, the rest wait for it. A
+// record reaches `map` only once it is on disk, so readers never see a
+// write a crash could lose; a failed flush discards its batch.
+// Startup replays "<path>.snapshot" (written by compact()) and then the log;
+// a torn record at the end of the log is cut off.
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>
+>
+class DurableMap {
+public:
+  enum Operation: uint8_t {
+    kPut = 1,
+    kErase = 2,
+  };
+
+  using Map = UnorderedMap<Key, Value, Hash, Equal>;
+
+  // A logged mutation waiting for its batch to reach the disk.
+  struct Staged {
+    uint64_t sequence;
+    Operation operation;
+    Key key;
+    std::optional<Value> value;
+  };
+
+  std::string path;
+  int fd = -1;
+  Map map;
+
+  mutable std::mutex mutex;
+  std::condition_variable flushed;
+  std::string pending;
+  std::vector<Staged> staged;
+  // Sequence of the newest unapplied record per key and whether it leaves
+  // the key present; writers decide against this before falling back to map.
+  UnorderedMap<Key, std::pair<uint64_t, bool>, Hash, Equal> latest;
+  uint64_t appended = 0;
+  uint64_t durable = 0;
+  bool flushing = false;
+  bool broken = false;
+
+  explicit DurableMap(std::string path): path(std::move(path)) {
+    replay(this->path + ".snapshot", false);
+    off_t good = replay(this->path, true);
+    fd = ::open(this->path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + this->path);
+    }
+    sync_directory();
+    if (::ftruncate(fd, good) != 0) {
+      throw std::system_error(errno, std::generic_category(), "ftruncate " + this->path);
+    }
+  }
+
+  DurableMap(const DurableMap&) = delete;
+  DurableMap& operator=(const DurableMap&) = delete;
+
+  ~DurableMap() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  static void encode(std::string& out, Operation operation, const Key& key, const Value* value) {
+    size_t start = out.size();
+    out.append(2 * sizeof(uint32_t), '\0');
+    out.push_back(static_cast<char>(operation));
+    JournalCodec<Key>::encode(out, key);
+    if (value != nullptr) {
+      JournalCodec<Value>::encode(out, *value);
+    }
+    uint32_t length = out.size() - start - 2 * sizeof(uint32_t);
+    uint32_t checksum = fast_hash_detail::hash_bytes(out.data() + start + 8, length);
+    std::memcpy(&out[start], &length, sizeof(length));
+    std::memcpy(&out[start + 4], &checksum, sizeof(checksum));
+  }
+
+  // Applies every intact record of a file; returns the offset after the last one.
+  off_t replay(const std::string& file, bool tolerate_torn_tail) {
+    int input = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (input < 0) {
+      if (errno == ENOENT) {
+        return 0;
+      }
+      throw std::system_error(errno, std::generic_category(), "open " + file);
+    }
+    std::string contents;
+    char buffer[1 << 16];
+    ssize_t got;
+    while ((got = ::read(input, buffer, sizeof(buffer))) > 0) {
+      contents.append(buffer, got);
+    }
+    ::close(input);
+    if (got < 0) {
+      throw std::system_error(errno, std::generic_category(), "read " + file);
+    }
+
+    const char* begin = contents.data();
+    const char* end = begin + contents.size();
+    const char* p = begin;
+    while (static_cast<size_t>(end - p) >= 2 * sizeof(uint32_t)) {
+      uint32_t length;
+      uint32_t checksum;
+      std::memcpy(&length, p, sizeof(length));
+      std::memcpy(&checksum, p + 4, sizeof(checksum));
+      const char* record = p + 8;
+      if (static_cast<size_t>(end - record) < length || length == 0 ||
+          static_cast<uint32_t>(fast_hash_detail::hash_bytes(record, length)) != checksum) {
+        break;
+      }
+      const char* record_end = record + length;
+      auto operation = static_cast<Operation>(*record++);
+      if (operation != kPut && operation != kErase) {
+        break;
+      }
+      Key key;
+      if (!JournalCodec<Key>::decode(record, record_end, key)) {
+        break;
+      }
+      if (operation == kPut) {
+        Value value;
+        if (!JournalCodec<Value>::decode(record, record_end, value)) {
+          break;
+        }
+        map[key] = std::move(value);
+      } else {
+        map.erase(key);
+      }
+      p = record_end;
+    }
+    if (p != end && !tolerate_torn_tail) {
+      throw std::runtime_error("corrupt journal snapshot " + file);
+    }
+    return p - begin;
+  }
+
+  static void write_all(int output, const std::string& data) {
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+      ssize_t written = ::write(output, p, left);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw std::system_error(errno, std::generic_category(), "write");
+      }
+      p += written;
+      left -= written;
+    }
+  }
+
+  // Blocks until record `sequence` is on disk, flushing as leader if needed.
+  void commit(uint64_t sequence, std::unique_lock<std::mutex>& lock) {
+    while (durable < sequence) {
+      if (broken) {
+        throw std::runtime_error("journal " + path + " is no longer writable");
+      }
+      if (flushing) {
+        flushed.wait(lock);
+        continue;
+      }
+      flushing = true;
+      std::string batch;
+      batch.swap(pending);
+      std::vector<Staged> records;
+      records.swap(staged);
+      uint64_t batch_end = appended;
+      lock.unlock();
+      try {
+        write_all(fd, batch);
+        if (::fdatasync(fd) != 0) {
+          throw std::system_error(errno, std::generic_category(), "fdatasync " + path);
+        }
+      } catch (...) {
+        lock.lock();
+        flushing = false;
+        broken = true;
+        staged.clear();
+        latest.clear();
+        flushed.notify_all();
+        throw;
+      }
+      lock.lock();
+      apply(records);
+      flushing = false;
+      durable = batch_end;
+      flushed.notify_all();
+    }
+  }
+
+  // Runs under the lock once a batch is durable, in log order.
+  void apply(std::vector<Staged>& records) {
+    for (Staged& record : records) {
+      if (record.operation == kPut) {
+        map[record.key] = std::move(*record.value);
+      } else {
+        map.erase(record.key);
+      }
+      auto it = latest.find(record.key);
+      if (it != latest.end() && it->second.first == record.sequence) {
+        latest.erase(it);
+      }
+    }
+  }
+
+  // Whether `key` is present once every logged record has been applied.
+  bool present(const Key& key) const {
+    auto it = latest.find(key);
+    return it != latest.cend() ? it->second.second : map.find(key) != map.cend();
+  }
+
+  void log(std::unique_lock<std::mutex>& lock, Operation operation, const Key& key, const Value* value) {
+    if (broken) {
+      throw std::runtime_error("journal " + path + " is no longer writable");
+    }
+    encode(pending, operation, key, value);
+    uint64_t sequence = ++appended;
+    staged.push_back({
+        sequence, operation, key,
+        value != nullptr ? std::optional<Value>(*value) : std::nullopt
+    });
+    latest[key] = {sequence, operation == kPut};
+    commit(sequence, lock);
+  }
+
+  bool insert(const Key& key, const Value& value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (present(key)) {
+      return false;
+    }
+    log(lock, kPut, key, &value);
+    return true;
+  }
+
+  void insert_or_assign(const Key& key, const Value& value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    log(lock, kPut, key, &value);
+  }
+
+  size_t erase(const Key& key) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!present(key)) {
+      return 0;
+    }
+    log(lock, kErase, key, nullptr);
+    return 1;
+  }
+
+  std::optional<Value> get(const Key& key) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = map.find(key);
+    if (it == map.cend()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  bool contains(const Key& key) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return map.find(key) != map.cend();
+  }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return map.size();
+  }
+
+  // Writes the whole map to "<path>.snapshot" and empties the log. Writers
+  // wait while this runs, so call it off the latency-critical path.
+  void compact() {
+    std::unique_lock<std::mutex> lock(mutex);
+    commit(appended, lock);
+    std::string image;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) {
+      encode(image, kPut, it->first, &it->second);
+    }
+    std::string temporary = path + ".snapshot.tmp";
+    int output = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (output < 0) {
+      throw std::system_error(errno, std::generic_category(), "open " + temporary);
+    }
+    try {
+      write_all(output, image);
+      if (::fsync(output) != 0) {
+        throw std::system_error(errno, std::generic_category(), "fsync " + temporary);
+      }
+    } catch (...) {
+      ::close(output);
+      throw;
+    }
+    ::close(output);
+    std::string snapshot = path + ".snapshot";
+    if (::rename(temporary.c_str(), snapshot.c_str()) != 0) {
+      throw std::system_error(errno, std::generic_category(), "rename " + snapshot);
+    }
+    sync_directory();
+    if (::ftruncate(fd, 0) != 0 || ::fdatasync(fd) != 0) {
+      throw std::system_error(errno, std::generic_category(), "truncate " + path);
+    }
+  }
+
+  void sync_directory() {
+    size_t slash = path.rfind('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int dir = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+      ::fsync(dir);
+      ::close(dir);
+    }
+  }
+};
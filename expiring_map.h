@@ -0,0 +1,251 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include "unordered_map.h"
+
+
+// Map whose entries carry a deadline on a caller-defined clock. Once the
+// clock, advanced by tick(now), reaches an entry's deadline, find() reports
+// a miss and tick() reclaims the entry. Deadlines live in a hierarchical
+// timer wheel: kLevels levels of 64 slots, level l covering 64^l ticks per
+// slot, with a bitmask of occupied slots per level. tick() visits only the
+// occupied slots whose time range it enters, and an entry cascades down at
+// most once per level, so expiry costs O(1) amortized per entry instead of
+// a sweep over the whole map.
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>
+>
+class ExpiringMap {
+public:
+  static constexpr uint64_t kNever = std::numeric_limits<uint64_t>::max();
+  static constexpr int kSlotBits = 6;
+  static constexpr size_t kSlots = size_t(1) << kSlotBits;
+  static constexpr int kLevels = (64 + kSlotBits - 1) / kSlotBits;
+  static constexpr uint8_t kOverdue = kLevels;
+  static constexpr uint8_t kUnlinked = 0xff;
+
+  using ExpiryCallback = std::function<void(const Key&, Value&)>;
+
+  class Entry {
+  public:
+    Value value;
+    uint64_t deadline;
+    const Key* key = nullptr;
+    Entry* prev = nullptr;
+    Entry* next = nullptr;
+    uint8_t level = kUnlinked;
+    uint8_t slot = 0;
+
+    template<typename... Args>
+    explicit Entry(uint64_t deadline, Args&&... args):
+        value(std::forward<Args>(args)...), deadline(deadline) {}
+  };
+
+  using Map = UnorderedMap<Key, Entry, Hash, Equal>;
+
+  Map map;
+  std::array<std::array<Entry*, kSlots>, kLevels> wheel{};
+  std::array<uint64_t, kLevels> occupied{};
+  Entry* overdue = nullptr;
+  uint64_t current;
+  ExpiryCallback on_expire;
+
+  explicit ExpiringMap(uint64_t now = 0, const Hash& hash = Hash(), const Equal& equal = Equal()):
+      map(1, hash, equal), current(now) {}
+
+  ExpiringMap(const ExpiringMap&) = delete;
+  ExpiringMap& operator=(const ExpiringMap&) = delete;
+
+  uint64_t now() const {
+    return current;
+  }
+
+  // Includes expired entries that tick() has not reclaimed yet.
+  size_t size() const {
+    return map.size();
+  }
+
+  void set_expiry_callback(ExpiryCallback callback) {
+    on_expire = std::move(callback);
+  }
+
+  static uint64_t rotate_left(uint64_t value, int count) {
+    count &= 63;
+    return count == 0 ? value : (value << count) | (value >> (64 - count));
+  }
+
+  Entry*& head_of(Entry* entry) {
+    return entry->level == kOverdue ? overdue : wheel[entry->level][entry->slot];
+  }
+
+  // Files the entry under the level where its deadline first differs from
+  // the current time; deadlines already reached wait on the overdue list.
+  void link(Entry* entry) {
+    if (entry->deadline == kNever) {
+      return;
+    }
+    if (entry->deadline <= current) {
+      entry->level = kOverdue;
+    } else {
+      int level = (63 - __builtin_clzll(entry->deadline ^ current)) / kSlotBits;
+      entry->level = level;
+      entry->slot = (entry->deadline >> (level * kSlotBits)) & (kSlots - 1);
+      occupied[level] |= uint64_t(1) << entry->slot;
+    }
+    Entry*& head = head_of(entry);
+    entry->prev = nullptr;
+    entry->next = head;
+    if (head != nullptr) {
+      head->prev = entry;
+    }
+    head = entry;
+  }
+
+  void unlink(Entry* entry) {
+    if (entry->level == kUnlinked) {
+      return;
+    }
+    Entry*& head = head_of(entry);
+    if (entry->prev != nullptr) {
+      entry->prev->next = entry->next;
+    } else {
+      head = entry->next;
+    }
+    if (entry->next != nullptr) {
+      entry->next->prev = entry->prev;
+    }
+    if (head == nullptr && entry->level != kOverdue) {
+      occupied[entry->level] &= ~(uint64_t(1) << entry->slot);
+    }
+    entry->level = kUnlinked;
+  }
+
+  Entry* lookup(const Key& key) const {
+    auto it = map.find(key);
+    return it != map.cend() ? const_cast<Entry*>(&it->second) : nullptr;
+  }
+
+  Value* find(const Key& key, uint64_t now) {
+    Entry* entry = lookup(key);
+    return entry != nullptr && entry->deadline > now ? &entry->value : nullptr;
+  }
+
+  const Value* find(const Key& key, uint64_t now) const {
+    return const_cast<ExpiringMap*>(this)->find(key, now);
+  }
+
+  Value* find(const Key& key) {
+    return find(key, current);
+  }
+
+  const Value* find(const Key& key) const {
+    return find(key, current);
+  }
+
+  bool contains(const Key& key) const {
+    return find(key) != nullptr;
+  }
+
+  // Inserts or replaces the value under `key`, live until `deadline`.
+  template<typename... Args>
+  Value& put(const Key& key, uint64_t deadline, Args&&... args) {
+    Entry* entry = lookup(key);
+    if (entry != nullptr) {
+      entry->value = Value(std::forward<Args>(args)...);
+    } else {
+      auto result = map.emplace(
+          std::piecewise_construct,
+          std::forward_as_tuple(key),
+          std::forward_as_tuple(kNever, std::forward<Args>(args)...)
+      );
+      entry = &result.first->second;
+      entry->key = &result.first->first;
+    }
+    unlink(entry);
+    entry->deadline = deadline;
+    link(entry);
+    return entry->value;
+  }
+
+  // Moves the deadline of a live entry; false if there is none.
+  bool expire_at(const Key& key, uint64_t deadline) {
+    Entry* entry = lookup(key);
+    if (entry == nullptr || entry->deadline <= current) {
+      return false;
+    }
+    unlink(entry);
+    entry->deadline = deadline;
+    link(entry);
+    return true;
+  }
+
+  // Removes the entry, live or not yet reclaimed; true if it was live.
+  bool erase(const Key& key) {
+    Entry* entry = lookup(key);
+    if (entry == nullptr) {
+      return false;
+    }
+    bool live = entry->deadline > current;
+    unlink(entry);
+    map.erase(key);
+    return live;
+  }
+
+  // Advances the clock to `now` and reclaims every entry whose deadline has
+  // passed; returns how many. At level l the slots entered are those of the
+  // 64^l-tick units in (current, now]; the rest of the wheel is not touched.
+  size_t tick(uint64_t now) {
+    if (now < current) {
+      return 0;
+    }
+    Entry* due = nullptr;
+    auto collect = [&due](Entry* head) {
+      while (head != nullptr) {
+        Entry* next = head->next;
+        head->next = due;
+        due = head;
+        head = next;
+      }
+    };
+    collect(std::exchange(overdue, nullptr));
+    for (int level = 0; level < kLevels; ++level) {
+      int shift = level * kSlotBits;
+      uint64_t width = (now >> shift) - (current >> shift);
+      if (width == 0) {
+        break;
+      }
+      uint64_t entered = width >= kSlots ? ~uint64_t(0) : rotate_left(
+          (uint64_t(1) << width) - 1, static_cast<int>((current >> shift) + 1)
+      );
+      for (uint64_t pending = entered & occupied[level]; pending != 0; pending &= pending - 1) {
+        collect(std::exchange(wheel[level][__builtin_ctzll(pending)], nullptr));
+      }
+      occupied[level] &= ~entered;
+    }
+    current = now;
+    size_t reclaimed = 0;
+    while (due != nullptr) {
+      Entry* entry = due;
+      due = entry->next;
+      entry->level = kUnlinked;
+      if (entry->deadline <= now) {
+        if (on_expire) {
+          on_expire(*entry->key, entry->value);
+        }
+        map.erase(*entry->key);
+        ++reclaimed;
+      } else {
+        link(entry);
+      }
+    }
+    return reclaimed;
+  }
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+
+namespace fast_hash_detail {
+
+constexpr uint64_t kSecret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+    0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+// 64x64 -> 128 bit multiply: a receives the low half, b the high half.
+inline void multiply(uint64_t& a, uint64_t& b) {
+#ifdef __SIZEOF_INT128__
+  __uint128_t product = static_cast<__uint128_t>(a) * b;
+  a = static_cast<uint64_t>(product);
+  b = static_cast<uint64_t>(product >> 64);
+#else
+  uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+  uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+  uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo, lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+  uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+  a = (cross << 32) | (lo_lo & 0xffffffff);
+  b = hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+inline uint64_t mix(uint64_t a, uint64_t b) {
+  multiply(a, b);
+  return a ^ b;
+}
+
+inline uint64_t read8(const unsigned char* p) {
+  uint64_t result;
+  std::memcpy(&result, p, sizeof(result));
+  return result;
+}
+
+inline uint64_t read4(const unsigned char* p) {
+  uint32_t result;
+  std::memcpy(&result, p, sizeof(result));
+  return result;
+}
+
+inline uint64_t mix_integer(uint64_t value) {
+  return mix(value ^ kSecret[0], kSecret[1]);
+}
+
+inline uint64_t combine(uint64_t seed, uint64_t value) {
+  return mix(seed ^ kSecret[2], value ^ kSecret[3]);
+}
+
+// wyhash-style: inputs up to 16 bytes take one multiply, longer ones are
+// consumed 16 bytes per multiply in three independent 48-byte lanes.
+inline uint64_t hash_bytes(const void* data, size_t length, uint64_t seed = 0) {
+  auto p = static_cast<const unsigned char*>(data);
+  seed ^= mix(seed ^ kSecret[0], kSecret[1]);
+  uint64_t a;
+  uint64_t b;
+  if (length <= 16) {
+    if (length >= 4) {
+      size_t shift = (length >> 3) << 2;
+      a = (read4(p) << 32) | read4(p + shift);
+      b = (read4(p + length - 4) << 32) | read4(p + length - 4 - shift);
+    } else if (length > 0) {
+      a = (static_cast<uint64_t>(p[0]) << 16) |
+          (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t left = length;
+    if (left > 48) {
+      uint64_t lane1 = seed;
+      uint64_t lane2 = seed;
+      do {
+        seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+        lane1 = mix(read8(p + 16) ^ kSecret[2], read8(p + 24) ^ lane1);
+        lane2 = mix(read8(p + 32) ^ kSecret[3], read8(p + 40) ^ lane2);
+        p += 48;
+        left -= 48;
+      } while (left > 48);
+      seed ^= lane1 ^ lane2;
+    }
+    while (left > 16) {
+      seed = mix(read8(p) ^ kSecret[1], read8(p + 8) ^ seed);
+      p += 16;
+      left -= 16;
+    }
+    a = read8(p + left - 16);
+    b = read8(p + left - 8);
+  }
+  a ^= kSecret[1];
+  b ^= seed;
+  multiply(a, b);
+  return mix(a ^ kSecret[0] ^ length, b ^ kSecret[1]);
+}
+
+template<typename T, typename = void>
+struct is_tuple_like: std::false_type {};
+
+template<typename T>
+struct is_tuple_like<T, std::void_t<decltype(std::tuple_size<T>::value)>>: std::true_type {};
+
+}  // namespace fast_hash_detail
+
+
+// Drop-in replacement for std::hash. Integers get a full-avalanche mixer
+// (std::hash is the identity for them in libstdc++, which clusters under
+// the modulo in get_hash), strings a wyhash-style byte hash, and pairs and
+// tuples combine their members. Anything else mixes std::hash's result.
+template<typename Key>
+struct FastHash {
+  size_t operator()(const Key& key) const {
+    if constexpr (std::is_integral_v<Key> || std::is_enum_v<Key>) {
+      return fast_hash_detail::mix_integer(static_cast<uint64_t>(key));
+    } else if constexpr (std::is_pointer_v<Key>) {
+      return fast_hash_detail::mix_integer(reinterpret_cast<uintptr_t>(key));
+    } else if constexpr (std::is_floating_point_v<Key>) {
+      double value = key == 0 ? 0.0 : static_cast<double>(key);
+      uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      return fast_hash_detail::mix_integer(bits);
+    } else if constexpr (std::is_convertible_v<const Key&, std::string_view>) {
+      std::string_view view = key;
+      return fast_hash_detail::hash_bytes(view.data(), view.size());
+    } else if constexpr (fast_hash_detail::is_tuple_like<Key>::value) {
+      return std::apply([](const auto&... items) {
+        uint64_t seed = std::tuple_size<Key>::value;
+        ((seed = fast_hash_detail::combine(
+            seed, FastHash<std::decay_t<decltype(items)>>()(items))), ...);
+        return static_cast<size_t>(seed);
+      }, key);
+    } else {
+      return fast_hash_detail::mix_integer(std::hash<Key>()(key));
+    }
+  }
+};
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "unordered_map.h"
+
+
+// Process-wide counters. `advised` counts regions the kernel accepted
+// MADV_HUGEPAGE for, `fallbacks` those left on normal pages; whether huge
+// pages actually back a region is reported by huge_page_bytes().
+struct HugePageStats {
+  static inline std::atomic<size_t> mapped_regions{0};
+  static inline std::atomic<size_t> mapped_bytes{0};
+  static inline std::atomic<size_t> advised{0};
+  static inline std::atomic<size_t> fallbacks{0};
+};
+
+namespace huge_page_detail {
+
+constexpr size_t kHugePageSize = size_t(2) << 20;
+
+inline size_t round_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Maps at least `bytes` on a 2 MiB boundary by over-mapping one huge page
+// and trimming both ends.
+inline void* map_region(size_t bytes) {
+  size_t length = round_up(bytes, kHugePageSize);
+  void* raw = ::mmap(nullptr, length + kHugePageSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  uintptr_t start = round_up(reinterpret_cast<uintptr_t>(raw), kHugePageSize);
+  size_t head = start - reinterpret_cast<uintptr_t>(raw);
+  if (head > 0) {
+    ::munmap(raw, head);
+  }
+  if (head < kHugePageSize) {
+    ::munmap(reinterpret_cast<char*>(start) + length, kHugePageSize - head);
+  }
+#ifdef MADV_HUGEPAGE
+  if (::madvise(reinterpret_cast<void*>(start), length, MADV_HUGEPAGE) == 0) {
+    ++HugePageStats::advised;
+  } else {
+    ++HugePageStats::fallbacks;
+  }
+#else
+  ++HugePageStats::fallbacks;
+#endif
+  ++HugePageStats::mapped_regions;
+  HugePageStats::mapped_bytes += length;
+  return reinterpret_cast<void*>(start);
+}
+
+inline void unmap_region(void* region, size_t bytes) {
+  size_t length = round_up(bytes, kHugePageSize);
+  ::munmap(region, length);
+  --HugePageStats::mapped_regions;
+  HugePageStats::mapped_bytes -= length;
+}
+
+// AnonHugePages of the mapping containing `address`, from /proc/self/smaps;
+// zero when it cannot be read.
+inline size_t huge_page_bytes(const void* address) {
+  FILE* smaps = std::fopen("/proc/self/smaps", "r");
+  if (smaps == nullptr) {
+    return 0;
+  }
+  auto target = reinterpret_cast<uintptr_t>(address);
+  bool inside = false;
+  size_t result = 0;
+  char line[512];
+  while (std::fgets(line, sizeof(line), smaps) != nullptr) {
+    unsigned long long start;
+    unsigned long long end;
+    size_t kilobytes;
+    if (std::sscanf(line, "%llx-%llx ", &start, &end) == 2) {
+      inside = start <= target && target < end;
+    } else if (inside && std::sscanf(line, "AnonHugePages: %zu kB", &kilobytes) == 1) {
+      result = kilobytes * 1024;
+      break;
+    }
+  }
+  std::fclose(smaps);
+  return result;
+}
+
+}  // namespace huge_page_detail
+
+
+// Slab pool for single-node allocations: every size class carves its
+// objects out of 2 MiB huge-page regions and recycles them through a free
+// list. Slabs are returned to the kernel only when the pool dies. Not
+// thread-safe; each container owns one (see HugePageAllocator).
+class HugePagePool {
+public:
+  static constexpr size_t kAlignment = alignof(std::max_align_t);
+
+  struct FreeSlot {
+    FreeSlot* next;
+  };
+
+  struct SizeClass {
+    size_t bytes;
+    FreeSlot* free_list;
+    char* cursor;
+    char* limit;
+  };
+
+  std::vector<SizeClass> classes;
+  std::vector<void*> slabs;
+
+  HugePagePool() = default;
+  HugePagePool(const HugePagePool&) = delete;
+  HugePagePool& operator=(const HugePagePool&) = delete;
+
+  ~HugePagePool() {
+    for (void* slab : slabs) {
+      huge_page_detail::unmap_region(slab, huge_page_detail::kHugePageSize);
+    }
+  }
+
+  SizeClass& size_class(size_t bytes) {
+    bytes = huge_page_detail::round_up(std::max(bytes, sizeof(FreeSlot)), kAlignment);
+    for (SizeClass& candidate : classes) {
+      if (candidate.bytes == bytes) {
+        return candidate;
+      }
+    }
+    classes.push_back({bytes, nullptr, nullptr, nullptr});
+    return classes.back();
+  }
+
+  void* allocate(size_t bytes) {
+    SizeClass& target = size_class(bytes);
+    if (target.free_list != nullptr) {
+      FreeSlot* slot = target.free_list;
+      target.free_list = slot->next;
+      return slot;
+    }
+    if (static_cast<size_t>(target.limit - target.cursor) < target.bytes) {
+      auto slab = static_cast<char*>(huge_page_detail::map_region(huge_page_detail::kHugePageSize));
+      slabs.push_back(slab);
+      target.cursor = slab;
+      target.limit = slab + huge_page_detail::kHugePageSize;
+    }
+    void* result = target.cursor;
+    target.cursor += target.bytes;
+    return result;
+  }
+
+  void deallocate(void* pointer, size_t bytes) {
+    SizeClass& target = size_class(bytes);
+    auto slot = static_cast<FreeSlot*>(pointer);
+    slot->next = target.free_list;
+    target.free_list = slot;
+  }
+
+  size_t huge_page_bytes() const {
+    size_t result = 0;
+    for (void* slab : slabs) {
+      result += huge_page_detail::huge_page_bytes(slab);
+    }
+    return result;
+  }
+};
+
+// Allocator that backs large arrays (the bucket array) with their own
+// 2 MiB-aligned MADV_HUGEPAGE mappings and single nodes with a pooled slab
+// of huge pages, so lookups in big maps touch few TLB entries. Mid-sized
+// arrays stay on the heap. Copies and rebinds share the pool; a container
+// copy gets a fresh one, and moving leaves the source a fresh one too, so
+// separate containers never share unsynchronized state. Meant for large
+// maps: each size class maps a full 2 MiB slab.
+template<typename T>
+class HugePageAllocator {
+public:
+  static constexpr size_t kPooledBytes = 256;
+  static constexpr size_t kDirectBytes = huge_page_detail::kHugePageSize / 2;
+
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::false_type;
+
+  std::shared_ptr<HugePagePool> pool;
+
+  HugePageAllocator(): pool(std::make_shared<HugePagePool>()) {}
+
+  HugePageAllocator(const HugePageAllocator& other) = default;
+  HugePageAllocator& operator=(const HugePageAllocator& other) = default;
+
+  // A moved-from container keeps allocating (its new list head, its one
+  // empty bucket), so it gets a pool of its own rather than none.
+  HugePageAllocator(HugePageAllocator&& other):
+      pool(std::exchange(other.pool, std::make_shared<HugePagePool>())) {}
+
+  HugePageAllocator& operator=(HugePageAllocator&& other) {
+    if (this != &other) {
+      pool = std::exchange(other.pool, std::make_shared<HugePagePool>());
+    }
+    return *this;
+  }
+
+  template<typename U>
+  HugePageAllocator(const HugePageAllocator<U>& other): pool(other.pool) {}
+
+  HugePageAllocator select_on_container_copy_construction() const {
+    return HugePageAllocator();
+  }
+
+  T* allocate(size_t n) {
+    size_t bytes = n * sizeof(T);
+    if (n == 1 && bytes <= kPooledBytes && alignof(T) <= HugePagePool::kAlignment) {
+      return static_cast<T*>(pool->allocate(bytes));
+    }
+    if (bytes >= kDirectBytes && alignof(T) <= huge_page_detail::kHugePageSize) {
+      return static_cast<T*>(huge_page_detail::map_region(bytes));
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, size_t n) {
+    size_t bytes = n * sizeof(T);
+    if (n == 1 && bytes <= kPooledBytes && alignof(T) <= HugePagePool::kAlignment) {
+      pool->deallocate(p, bytes);
+    } else if (bytes >= kDirectBytes && alignof(T) <= huge_page_detail::kHugePageSize) {
+      huge_page_detail::unmap_region(p, bytes);
+    } else {
+      std::allocator<T>().deallocate(p, n);
+    }
+  }
+
+  template<typename U>
+  bool operator==(const HugePageAllocator<U>& other) const {
+    return pool == other.pool;
+  }
+
+  template<typename U>
+  bool operator!=(const HugePageAllocator<U>& other) const {
+    return pool != other.pool;
+  }
+};
+
+namespace huge {
+
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>,
+    typename GrowthPolicy = DefaultGrowthPolicy,
+    typename Filter = NoFilter
+>
+using UnorderedMap = ::UnorderedMap<
+    Key, Value, Hash, Equal,
+    HugePageAllocator<std::pair<const Key, Value>>,
+    GrowthPolicy, Filter
+>;
+
+}  // namespace huge
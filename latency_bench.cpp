@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "unordered_map.h"
+#include "seeded_hash.h"
+#include "adaptive_map.h"
+#include "huge_page_allocator.h"
+
+
+// Log-linear histogram in the spirit of HdrHistogram: values below 64 ns are
+// exact, larger ones land in one of 32 sub-buckets per power of two, which
+// bounds the reported error of any percentile to about 3%.
+class LatencyHistogram {
+  static constexpr int kSubBits = 5;
+  static constexpr uint64_t kSubCount = 1 << kSubBits;
+  static constexpr uint64_t kExact = 2 * kSubCount;
+
+  std::vector<uint64_t> counts;
+  uint64_t total = 0;
+  uint64_t sum = 0;
+  uint64_t largest = 0;
+
+  static int log2(uint64_t value) {
+    return 63 - __builtin_clzll(value);
+  }
+
+  static size_t index(uint64_t value) {
+    if (value < kExact) {
+      return value;
+    }
+    int shift = log2(value) - kSubBits;
+    return kExact + (shift - 1) * kSubCount + ((value >> shift) - kSubCount);
+  }
+
+  static uint64_t upper_bound(size_t index) {
+    if (index < kExact) {
+      return index;
+    }
+    int shift = static_cast<int>((index - kExact) / kSubCount) + 1;
+    uint64_t sub = (index - kExact) % kSubCount + kSubCount;
+    return ((sub + 1) << shift) - 1;
+  }
+public:
+  LatencyHistogram(): counts(kExact + (64 - kSubBits) * kSubCount, 0) {}
+
+  void record(uint64_t nanoseconds) {
+    ++counts[index(nanoseconds)];
+    ++total;
+    sum += nanoseconds;
+    largest = std::max(largest, nanoseconds);
+  }
+
+  uint64_t count() const {
+    return total;
+  }
+
+  double mean() const {
+    return total == 0 ? 0 : static_cast<double>(sum) / total;
+  }
+
+  uint64_t max() const {
+    return largest;
+  }
+
+  uint64_t percentile(double fraction) const {
+    uint64_t rank = static_cast<uint64_t>(fraction * total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen > rank) {
+        return std::min(upper_bound(i), largest);
+      }
+    }
+    return largest;
+  }
+};
+
+struct Result {
+  std::string scenario;
+  std::string operation;
+  LatencyHistogram histogram;
+};
+
+class Recorder {
+  std::deque<Result> results;
+public:
+  LatencyHistogram& histogram(const std::string& scenario, const std::string& operation) {
+    for (auto& result : results) {
+      if (result.scenario == scenario && result.operation == operation) {
+        return result.histogram;
+      }
+    }
+    results.push_back({scenario, operation, LatencyHistogram()});
+    return results.back().histogram;
+  }
+
+  void print(std::ostream& out) const {
+    out << std::left << std::setw(14) << "scenario" << std::setw(12) << "operation"
+        << std::right << std::setw(10) << "count" << std::setw(10) << "p50"
+        << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(12) << "max"
+        << "  (ns)\n";
+    for (auto& result : results) {
+      auto& h = result.histogram;
+      out << std::left << std::setw(14) << result.scenario << std::setw(12) << result.operation
+          << std::right << std::setw(10) << h.count() << std::setw(10) << h.percentile(0.5)
+          << std::setw(10) << h.percentile(0.99) << std::setw(10) << h.percentile(0.999)
+          << std::setw(12) << h.max() << "\n";
+    }
+  }
+
+  void write_csv(std::ostream& out, const std::string& label) const {
+    out << "label,scenario,operation,count,mean_ns,p50_ns,p99_ns,p999_ns,max_ns\n";
+    for (auto& result : results) {
+      auto& h = result.histogram;
+      out << label << ',' << result.scenario << ',' << result.operation << ','
+          << h.count() << ',' << h.mean() << ',' << h.percentile(0.5) << ','
+          << h.percentile(0.99) << ',' << h.percentile(0.999) << ',' << h.max() << '\n';
+    }
+  }
+};
+
+template<typename Operation>
+void timed(LatencyHistogram& histogram, Operation&& operation) {
+  auto start = std::chrono::steady_clock::now();
+  operation();
+  auto stop = std::chrono::steady_clock::now();
+  histogram.record(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count()
+  );
+}
+
+volatile long long sink;
+
+template<typename Map>
+void RunGrowing(Recorder& recorder, const std::string& scenario, const std::vector<long long>& keys) {
+  Map m;
+  auto& insert = recorder.histogram(scenario, "insert");
+  for (long long key : keys) {
+    timed(insert, [&] { m.insert({key, key}); });
+  }
+  auto& find_hit = recorder.histogram(scenario, "find_hit");
+  for (long long key : keys) {
+    timed(find_hit, [&] { sink = m.find(key)->second; });
+  }
+  auto& find_miss = recorder.histogram(scenario, "find_miss");
+  for (long long key : keys) {
+    timed(find_miss, [&] { sink = m.find(~key) == m.end(); });
+  }
+  auto& subscript = recorder.histogram(scenario, "operator[]");
+  for (size_t i = 0; i < keys.size(); ++i) {
+    long long key = i % 2 == 0 ? keys[i] : -keys[i] - 1;
+    timed(subscript, [&] { sink = ++m[key]; });
+  }
+  auto& erase = recorder.histogram(scenario, "erase");
+  for (long long key : keys) {
+    timed(erase, [&] { sink = m.erase(key); });
+  }
+}
+
+// Insert-then-erase-from-front, as in TestCustomAlloc: size stays constant
+// while nodes keep being allocated and released.
+template<typename Map>
+void RunChurn(Recorder& recorder, const std::string& scenario, const std::vector<long long>& keys) {
+  Map m;
+  size_t live = keys.size() / 2;
+  for (size_t i = 0; i < live; ++i) {
+    m.emplace(keys[i], keys[i]);
+  }
+  auto& insert = recorder.histogram(scenario, "insert");
+  auto& erase = recorder.histogram(scenario, "erase");
+  for (size_t i = live; i < keys.size(); ++i) {
+    timed(insert, [&] { m.emplace(keys[i], keys[i]); });
+    timed(erase, [&] { m.erase(m.begin()); });
+  }
+}
+
+// Every key is a multiple of the reserved bucket count, so with an identity
+// hash they all share bucket zero.
+template<typename Map>
+void RunAdversarial(Recorder& recorder, const std::string& scenario, size_t count) {
+  Map m;
+  m.reserve(count);
+  long long stride = static_cast<long long>(m.hash_array.size());
+  auto& insert = recorder.histogram(scenario, "insert");
+  for (size_t i = 0; i < count; ++i) {
+    long long key = static_cast<long long>(i) * stride;
+    timed(insert, [&] { m.insert({key, key}); });
+  }
+  auto& find_hit = recorder.histogram(scenario, "find_hit");
+  for (size_t i = 0; i < count; ++i) {
+    long long key = static_cast<long long>(i) * stride;
+    timed(find_hit, [&] { sink = m.find(key)->second; });
+  }
+}
+
+int main(int argc, char** argv) {
+  size_t count = 1'000'000;
+  size_t adversarial_count = 20'000;
+  std::string csv_path;
+  std::string label = "current";
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--count" && i + 1 < argc) {
+      count = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--adversarial-count" && i + 1 < argc) {
+      adversarial_count = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--csv" && i + 1 < argc) {
+      csv_path = argv[++i];
+    } else if (arg == "--label" && i + 1 < argc) {
+      label = argv[++i];
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--count N] [--adversarial-count N] [--csv FILE] [--label NAME]\n";
+      return 1;
+    }
+  }
+
+  std::mt19937_64 generator(42);
+  std::vector<long long> keys(count);
+  for (auto& key : keys) {
+    key = static_cast<long long>(generator() >> 2);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  std::shuffle(keys.begin(), keys.end(), generator);
+
+  Recorder recorder;
+  RunGrowing<UnorderedMap<long long, long long>>(recorder, "growing", keys);
+  RunGrowing<AdaptiveUnorderedMap<long long, long long>>(recorder, "adaptive", keys);
+  RunGrowing<huge::UnorderedMap<long long, long long>>(recorder, "huge_pages", keys);
+  RunGrowing<UnorderedMap<long long, long long, DefaultHash<long long>, std::equal_to<long long>,
+                          std::allocator<std::pair<const long long, long long>>,
+                          DefaultGrowthPolicy, BlockedBloomFilter>>(recorder, "bloom", keys);
+  RunChurn<UnorderedMap<long long, long long>>(recorder, "churn", keys);
+  RunAdversarial<UnorderedMap<long long, long long>>(
+      recorder, "adversarial", adversarial_count
+  );
+  RunAdversarial<UnorderedMap<long long, long long, SeededHash<long long>>>(
+      recorder, "adv_seeded", adversarial_count
+  );
+
+  recorder.print(std::cout);
+  std::cout << "huge page regions: " << HugePageStats::advised << " advised, "
+            << HugePageStats::fallbacks << " on normal pages\n";
+  if (!csv_path.empty()) {
+    std::ofstream out(csv_path);
+    recorder.write_csv(out, label);
+  }
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "unordered_map.h"
+
+
+// Fixed-capacity cache. Each entry is a single node linked into its bucket
+// chain and into the recency list, so get() only relinks pointers. Nodes
+// are reused on eviction: the cache allocates at most capacity() of them.
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>,
+    typename Allocator = std::allocator<std::pair<const Key, Value>>
+>
+class LruCache {
+public:
+  using NodeType = std::pair<const Key, Value>;
+  using EvictionCallback = std::function<void(const Key&, Value&)>;
+
+  class Entry {
+  public:
+    Entry* bucket_next = nullptr;
+    Entry* newer = nullptr;
+    Entry* older = nullptr;
+    size_t hash;
+    NodeType value;
+
+    template<typename... Args>
+    explicit Entry(size_t hash, Args&&... args):
+        hash(hash), value(std::forward<Args>(args)...) {}
+  };
+
+  using EntryAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>;
+  using EntryTraits = std::allocator_traits<EntryAllocator>;
+  using BucketAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Entry*>;
+
+  template<bool IsConst>
+  class iterator_impl {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<IsConst, const NodeType*, NodeType*>;
+    using reference = std::conditional_t<IsConst, const NodeType&, NodeType&>;
+
+    Entry* entry;
+
+    iterator_impl(Entry* entry): entry(entry) {}
+
+    reference operator*() const {
+      return entry->value;
+    }
+
+    pointer operator->() const {
+      return &entry->value;
+    }
+
+    iterator_impl& operator++() {
+      entry = entry->older;
+      return *this;
+    }
+
+    iterator_impl operator++(int) {
+      auto copy = *this;
+      entry = entry->older;
+      return copy;
+    }
+
+    bool operator==(const iterator_impl& other) const {
+      return entry == other.entry;
+    }
+
+    bool operator!=(const iterator_impl& other) const {
+      return entry != other.entry;
+    }
+  };
+
+  using iterator = iterator_impl<false>;
+  using const_iterator = iterator_impl<true>;
+
+  std::vector<Entry*, BucketAllocator> buckets;
+  Hash hash_function;
+  Equal equal_key;
+  EntryAllocator allocator;
+  EvictionCallback on_evict;
+  Entry* newest = nullptr;
+  Entry* oldest = nullptr;
+  Entry* spare = nullptr;
+  size_t length = 0;
+  size_t max_size;
+
+  explicit LruCache(
+      size_t capacity,
+      const Hash& hash = Hash(),
+      const Equal& equal = Equal(),
+      const Allocator& alloc = Allocator()):
+      buckets(BucketAllocator(alloc)),
+      hash_function(hash),
+      equal_key(equal),
+      allocator(alloc),
+      max_size(capacity > 0 ? capacity : 1) {
+    buckets.resize(static_cast<size_t>(max_size / 0.75f) + 1, nullptr);
+  }
+
+  LruCache(const LruCache&) = delete;
+  LruCache& operator=(const LruCache&) = delete;
+
+  LruCache(LruCache&& other) noexcept:
+      buckets(std::move(other.buckets)),
+      hash_function(std::move(other.hash_function)),
+      equal_key(std::move(other.equal_key)),
+      allocator(std::move(other.allocator)),
+      on_evict(std::move(other.on_evict)),
+      newest(std::exchange(other.newest, nullptr)),
+      oldest(std::exchange(other.oldest, nullptr)),
+      spare(std::exchange(other.spare, nullptr)),
+      length(std::exchange(other.length, 0)),
+      max_size(other.max_size) {}
+
+  ~LruCache() {
+    clear();
+    while (spare != nullptr) {
+      Entry* next = spare->bucket_next;
+      EntryTraits::deallocate(allocator, spare, 1);
+      spare = next;
+    }
+  }
+
+  size_t size() const {
+    return length;
+  }
+
+  size_t capacity() const {
+    return max_size;
+  }
+
+  void set_eviction_callback(EvictionCallback callback) {
+    on_evict = std::move(callback);
+  }
+
+  size_t get_hash(const Key& key) const {
+    return hash_function(key);
+  }
+
+  Entry*& bucket(size_t hash) {
+    return buckets[hash % buckets.size()];
+  }
+
+  Entry* lookup(const Key& key, size_t hash) const {
+    Entry* entry = buckets[hash % buckets.size()];
+    while (entry != nullptr && !(entry->hash == hash && equal_key(entry->value.first, key))) {
+      entry = entry->bucket_next;
+    }
+    return entry;
+  }
+
+  void unlink_recency(Entry* entry) {
+    (entry->newer != nullptr ? entry->newer->older : newest) = entry->older;
+    (entry->older != nullptr ? entry->older->newer : oldest) = entry->newer;
+  }
+
+  void link_newest(Entry* entry) {
+    entry->newer = nullptr;
+    entry->older = newest;
+    (newest != nullptr ? newest->newer : oldest) = entry;
+    newest = entry;
+  }
+
+  void unlink_bucket(Entry* entry) {
+    Entry** link = &bucket(entry->hash);
+    while (*link != entry) {
+      link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+  }
+
+  void touch(Entry* entry) {
+    if (entry != newest) {
+      unlink_recency(entry);
+      link_newest(entry);
+    }
+  }
+
+  // Detaches an entry and destroys its pair, leaving raw storage for reuse.
+  Entry* release(Entry* entry) {
+    unlink_bucket(entry);
+    unlink_recency(entry);
+    EntryTraits::destroy(allocator, entry);
+    --length;
+    return entry;
+  }
+
+  Value* get(const Key& key) {
+    Entry* entry = lookup(key, get_hash(key));
+    if (entry == nullptr) {
+      return nullptr;
+    }
+    touch(entry);
+    return &entry->value.second;
+  }
+
+  const Value* peek(const Key& key) const {
+    Entry* entry = lookup(key, get_hash(key));
+    return entry != nullptr ? &entry->value.second : nullptr;
+  }
+
+  bool contains(const Key& key) const {
+    return lookup(key, get_hash(key)) != nullptr;
+  }
+
+  template<typename... Args>
+  Value& put(const Key& key, Args&&... args) {
+    size_t hash = get_hash(key);
+    Entry* entry = lookup(key, hash);
+    if (entry != nullptr) {
+      entry->value.second = Value(std::forward<Args>(args)...);
+      touch(entry);
+      return entry->value.second;
+    }
+    // The new entry is built before the oldest one is evicted, so a throwing
+    // construction leaves the cache as it was.
+    Entry* storage;
+    if (spare != nullptr) {
+      storage = spare;
+      spare = spare->bucket_next;
+    } else {
+      storage = EntryTraits::allocate(allocator, 1);
+    }
+    try {
+      EntryTraits::construct(
+          allocator, storage, hash,
+          std::piecewise_construct,
+          std::forward_as_tuple(key),
+          std::forward_as_tuple(std::forward<Args>(args)...)
+      );
+    } catch (...) {
+      storage->bucket_next = spare;
+      spare = storage;
+      throw;
+    }
+    if (length == max_size) {
+      try {
+        if (on_evict) {
+          on_evict(oldest->value.first, oldest->value.second);
+        }
+      } catch (...) {
+        EntryTraits::destroy(allocator, storage);
+        storage->bucket_next = spare;
+        spare = storage;
+        throw;
+      }
+      Entry* evicted = release(oldest);
+      evicted->bucket_next = spare;
+      spare = evicted;
+    }
+    Entry*& head = bucket(hash);
+    storage->bucket_next = head;
+    head = storage;
+    link_newest(storage);
+    ++length;
+    return storage->value.second;
+  }
+
+  bool erase(const Key& key) {
+    Entry* entry = lookup(key, get_hash(key));
+    if (entry == nullptr) {
+      return false;
+    }
+    release(entry)->bucket_next = spare;
+    spare = entry;
+    return true;
+  }
+
+  void clear() {
+    while (oldest != nullptr) {
+      Entry* entry = release(oldest);
+      entry->bucket_next = spare;
+      spare = entry;
+    }
+  }
+
+  iterator begin() {
+    return newest;
+  }
+
+  const_iterator begin() const {
+    return newest;
+  }
+
+  iterator end() {
+    return nullptr;
+  }
+
+  const_iterator end() const {
+    return nullptr;
+  }
+};
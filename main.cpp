@@ -1,6 +1,22 @@
 #include <vector>
 #include <string>
 #include "unordered_map.h"
+#include "seeded_hash.h"
+#include "string_map.h"
+#include "lru_cache.h"
+#include "unordered_multimap.h"
+#include "fast_hash.h"
+#include "snapshot_map.h"
+#include "durable_map.h"
+#include "adaptive_map.h"
+#include "unordered_set.h"
+#include "huge_page_allocator.h"
+#include "expiring_map.h"
+#include <atomic>
+#include <map>
+#include <random>
+#include <thread>
+#include <unistd.h>
 #include <cassert>
 #include <iostream>
 
@@ -354,11 +370,994 @@ void TestCustomAlloc() {
   }
 }
 
+struct CollidingUntilReseed {
+  uint64_t seed = 0;
+
+  size_t operator()(int x) const {
+    return seed == 0 ? 0 : std::hash<int>()(x) * seed;
+  }
+
+  void reseed() {
+    ++seed;
+  }
+};
+
+void TestSeededHash() {
+  SeededHash<std::string> first;
+  SeededHash<std::string> second;
+  SeededHash<std::string> same(first.k0, first.k1);
+  assert(first("flood") == same("flood"));
+  assert(first("flood") != second("flood") || first("food") != second("food"));
+  assert(SeededHash<int>(1, 2)(5) == SeededHash<int>(1, 2)(5));
+
+  UnorderedMap<std::string, int, SeededHash<std::string>> m;
+  for (int i = 0; i < 1000; ++i) {
+    m[std::to_string(i)] = i;
+  }
+  auto copy = m;
+  for (int i = 0; i < 1000; ++i) {
+    assert(copy.at(std::to_string(i)) == i);
+  }
+
+  UnorderedMap<int, int, CollidingUntilReseed> flooded;
+  for (int i = 0; i < 1000; ++i) {
+    flooded.emplace(i, i);
+  }
+  assert(flooded.hash_function.seed > 0);
+  assert(flooded.next_reseed_size > 0);
+  auto flooded_copy = flooded;
+  assert(flooded_copy.next_reseed_size == flooded.next_reseed_size);
+  for (int i = 0; i < 1000; ++i) {
+    assert(flooded.at(i) == i);
+  }
+  size_t bucket = flooded.get_hash(0);
+  size_t chain = 0;
+  flooded.find_in_bucket(-1, bucket, chain);
+  assert(chain < flooded.max_chain_length());
+}
+
+void TestStringMap() {
+  StringMap<int> m;
+  std::string long_key(100, 'x');
+  m["short"] = 1;
+  m[long_key] = 2;
+  assert(m.size() == 2);
+  assert(m.at("short") == 1);
+  assert(m.at(long_key) == 2);
+  assert(m.find(std::string(99, 'x')) == m.end());
+  assert(!m.insert("short", 5).second);
+  assert(m.arena.bytes_used() == long_key.size());
+
+  for (int i = 0; i < 10000; ++i) {
+    m[std::string(30, 'a') + std::to_string(i)] = i;
+  }
+  auto copy = m;
+  assert(m.erase("short") == 1);
+  assert(m.erase("short") == 0);
+  assert(copy.at("short") == 1);
+  for (int i = 0; i < 10000; ++i) {
+    assert(copy.at(std::string(30, 'a') + std::to_string(i)) == i);
+  }
+
+  size_t total = 0;
+  for (auto& item : copy) {
+    total += item.first.view().size();
+  }
+  assert(total == 5 + 100 + 10000 * 30 + 38890);
+
+  StringMap<int> moved = std::move(copy);
+  assert(moved.at(long_key) == 2);
+  std::string left_key(60, 'l');
+  std::string right_key(60, 'r');
+  copy[left_key] = 3;
+  moved[right_key] = 4;
+  assert(copy.size() == 1 && copy.at(left_key) == 3);
+  assert(copy.begin()->first.view() == left_key);
+  assert(moved.at(right_key) == 4 && moved.at(long_key) == 2);
+  for (int i = 0; i < 10000; ++i) {
+    assert(moved.at(std::string(30, 'a') + std::to_string(i)) == i);
+  }
+}
+
+template<typename T>
+struct CountingAllocator {
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using is_always_equal = std::false_type;
+
+  long long* live;
+
+  explicit CountingAllocator(long long* live): live(live) {}
+
+  template<typename U>
+  CountingAllocator(const CountingAllocator<U>& other): live(other.live) {}
+
+  T* allocate(size_t n) {
+    ++*live;
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, size_t n) {
+    --*live;
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  template<typename U>
+  bool operator==(const CountingAllocator<U>& other) const {
+    return live == other.live;
+  }
+
+  template<typename U>
+  bool operator!=(const CountingAllocator<U>& other) const {
+    return live != other.live;
+  }
+};
+
+template<typename T>
+struct FailingAllocator {
+  using value_type = T;
+
+  // Allocations left before bad_alloc; negative means unlimited.
+  long long* budget;
+
+  explicit FailingAllocator(long long* budget): budget(budget) {}
+
+  template<typename U>
+  FailingAllocator(const FailingAllocator<U>& other): budget(other.budget) {}
+
+  T* allocate(size_t n) {
+    if (*budget == 0) {
+      throw std::bad_alloc();
+    }
+    if (*budget > 0) {
+      --*budget;
+    }
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, size_t n) {
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  template<typename U>
+  bool operator==(const FailingAllocator<U>& other) const {
+    return budget == other.budget;
+  }
+
+  template<typename U>
+  bool operator!=(const FailingAllocator<U>& other) const {
+    return budget != other.budget;
+  }
+};
+
+void TestStatefulAllocator() {
+  using Alloc = CountingAllocator<std::pair<const int, int>>;
+  long long first_live = 0;
+  long long second_live = 0;
+  {
+    UnorderedMap<int, int, std::hash<int>, std::equal_to<int>, Alloc> m{Alloc(&first_live)};
+    for (int i = 0; i < 1000; ++i) {
+      m[i] = i;
+    }
+    assert(first_live > 1000);
+    for (int i = 0; i < 500; ++i) {
+      m.erase(i);
+    }
+
+    UnorderedMap<int, int, std::hash<int>, std::equal_to<int>, Alloc> mm{Alloc(&second_live)};
+    mm[-1] = -1;
+    mm = m;
+    assert(mm.at(700) == 700);
+    assert(mm.get_allocator() == m.get_allocator());
+    auto copy = mm;
+    assert(copy.size() == 500);
+  }
+  assert(first_live == 0);
+  assert(second_live == 0);
+
+  std::pmr::monotonic_buffer_resource arena;
+  std::pmr::unsynchronized_pool_resource pool;
+  {
+    pmr::UnorderedMap<std::pmr::string, int> m(&arena);
+    for (int i = 0; i < 1000; ++i) {
+      m.emplace(std::string(40, 'k') + std::to_string(i), i);
+    }
+    for (auto& item : m) {
+      assert(item.first.get_allocator().resource() == &arena);
+    }
+    pmr::UnorderedMap<std::pmr::string, int> other(&pool);
+    other = std::move(m);
+    assert(other.size() == 1000);
+    assert(other.get_allocator().resource() == &pool);
+    assert(other.begin()->first.get_allocator().resource() == &pool);
+    assert(other.at(std::pmr::string(40, 'k') + "999") == 999);
+  }
+  {
+    pmr::UnorderedMap<int, std::unique_ptr<int>> owners(&arena);
+    owners.emplace(1, std::make_unique<int>(10));
+    pmr::UnorderedMap<int, std::unique_ptr<int>> target(&pool);
+    target = std::move(owners);
+    assert(*target.at(1) == 10);
+  }
+  static_assert(std::is_nothrow_move_assignable_v<UnorderedMap<int, int>>);
+  static_assert(!std::is_nothrow_move_assignable_v<pmr::UnorderedMap<int, int>>);
+  static_assert(std::is_nothrow_move_assignable_v<UnorderedMultiMap<int, int>>);
+}
+
+void TestLruCache() {
+  LruCache<int, std::string> cache(3);
+  std::vector<int> evicted;
+  cache.set_eviction_callback([&evicted](const int& key, std::string&) {
+    evicted.push_back(key);
+  });
+  cache.put(1, "one");
+  cache.put(2, "two");
+  cache.put(3, "three");
+  assert(*cache.get(1) == "one");
+  cache.put(4, "four");
+  assert(evicted == std::vector<int>{2});
+  assert(cache.get(2) == nullptr);
+  assert(cache.size() == 3);
+
+  cache.put(3, "drei");
+  cache.put(5, "five");
+  assert(evicted == (std::vector<int>{2, 1}));
+  std::vector<int> order;
+  for (auto& item : cache) {
+    order.push_back(item.first);
+  }
+  assert(order == (std::vector<int>{5, 3, 4}));
+  assert(*cache.peek(3) == "drei");
+
+  assert(cache.erase(4));
+  assert(!cache.erase(4));
+  assert(!cache.contains(4));
+  cache.put(6, "six");
+  assert(cache.size() == 3);
+  assert(evicted.size() == 2);
+  try {
+    cache.put(7, std::string::npos, 'x');
+    assert(false);
+  } catch (std::length_error&) {}
+  assert(cache.size() == 3);
+  assert(evicted.size() == 2);
+  assert(!cache.contains(7));
+  cache.put(7, "seven");
+  assert(*cache.get(7) == "seven");
+  assert(cache.size() == 3);
+  assert(evicted.size() == 3);
+
+  LruCache<int, int> big(1000);
+  for (int i = 0; i < 100'000; ++i) {
+    big.put(i, i);
+    if (i % 3 == 0) {
+      assert(big.get(i / 2) == nullptr || *big.get(i / 2) == i / 2);
+    }
+  }
+  assert(big.size() == 1000);
+  assert(*big.get(99'999) == 99'999);
+  LruCache<int, int> moved = std::move(big);
+  assert(moved.contains(99'000));
+}
+
+void TestUnorderedMultiMap() {
+  UnorderedMultiMap<std::string, int> m;
+  for (int i = 0; i < 1000; ++i) {
+    m.emplace(std::to_string(i % 100), i);
+  }
+  assert(m.size() == 1000);
+  for (int k = 0; k < 100; ++k) {
+    auto range = m.equal_range(std::to_string(k));
+    int seen = 0;
+    for (auto it = range.first; it != range.second; ++it) {
+      assert(it->second % 100 == k);
+      ++seen;
+    }
+    assert(seen == 10);
+  }
+  assert(m.count("nope") == 0);
+
+  std::vector<int> postings(500);
+  for (int i = 0; i < 500; ++i) {
+    postings[i] = -i;
+  }
+  m.insert("7", postings.begin(), postings.end());
+  m.insert("fresh", postings.begin(), postings.begin() + 3);
+  assert(m.count("7") == 510);
+  assert(m.count("fresh") == 3);
+  assert(m.size() == 1503);
+
+  auto copy = m;
+  assert(copy.count("7") == 510);
+  assert(m.erase("7") == 510);
+  assert(m.count("7") == 0);
+  assert(m.size() == 993);
+  assert(copy.size() == 1503);
+
+  m.rehash(7);
+  for (int k = 0; k < 100; ++k) {
+    assert(m.count(std::to_string(k)) == (k == 7 ? 0 : 10));
+  }
+}
+
+void TestFastHash() {
+  FastHash<int> int_hash;
+  assert(int_hash(1) != int_hash(2));
+  assert(int_hash(1) != 1);
+  FastHash<double> double_hash;
+  assert(double_hash(0.0) == double_hash(-0.0));
+
+  FastHash<std::string> string_hash;
+  std::string text(200, 'q');
+  assert(string_hash(text) == FastHash<std::string_view>()(text));
+  for (size_t length = 0; length < 100; ++length) {
+    std::string changed = text.substr(0, length);
+    size_t before = string_hash(changed);
+    if (length > 0) {
+      changed[length / 2] = 'r';
+      assert(string_hash(changed) != before);
+    }
+    assert(string_hash(text.substr(0, length + 1)) != before);
+  }
+
+  FastHash<std::pair<int, int>> pair_hash;
+  assert((pair_hash({1, 2}) != pair_hash({2, 1})));
+  assert((pair_hash({1, 2}) == FastHash<std::tuple<int, int>>()(std::make_tuple(1, 2))));
+
+  UnorderedMap<std::pair<int, int>, int, FastHash<std::pair<int, int>>> m;
+  for (int i = 0; i < 300; ++i) {
+    for (int j = 0; j < 300; ++j) {
+      m[{i, j}] = i * j;
+    }
+  }
+  assert((m.at({17, 42}) == 17 * 42));
+  size_t longest = 0;
+  for (size_t bucket = 0; bucket < m.hash_array.size(); ++bucket) {
+    size_t chain = 0;
+    m.find_in_bucket({-1, -1}, bucket, chain);
+    longest = std::max(longest, chain);
+  }
+  assert(longest < 16);
+}
+
+void TestSnapshotMap() {
+  SnapshotMap<int, std::string> m;
+  for (int i = 0; i < 10000; ++i) {
+    m.insert_or_assign(i, std::to_string(i));
+  }
+  assert(m.size() == 10000);
+
+  auto snapshot = m.snapshot();
+  assert(snapshot.table == m.table);
+  m.insert_or_assign(5, "five");
+  assert(m.insert({-1, "minus one"}));
+  assert(!m.insert({-1, "again"}));
+  assert(m.erase(6) == 1);
+  assert(m.erase(6) == 0);
+
+  assert(snapshot.at(5) == "5");
+  assert(snapshot.at(6) == "6");
+  assert(snapshot.count(-1) == 0);
+  assert(snapshot.size() == 10000);
+  assert(m.at(5) == "five");
+  assert(m.count(6) == 0);
+  assert(m.size() == 10000);
+
+  size_t shared = 0;
+  for (size_t i = 0; i < m.kSegmentCount; ++i) {
+    shared += m.segment(i) == snapshot.segment(i);
+  }
+  assert(shared + 3 >= m.kSegmentCount);
+
+  size_t seen = 0;
+  long long sum = 0;
+  for (auto& item : snapshot) {
+    ++seen;
+    sum += item.first;
+  }
+  assert(seen == 10000);
+  assert(sum == 9999LL * 10000 / 2);
+
+  auto before = m.snapshot();
+  assert(!m.insert_or_assign(7, "seven"));
+  assert(m.insert_or_assign(-2, 3, 'x'));
+  assert(m.at(7) == "seven" && m.at(-2) == "xxx");
+  assert(before.at(7) == "7" && before.count(-2) == 0);
+  assert(m.size() == 10001);
+  m.erase(-2);
+
+  SnapshotMap<int, int> empty;
+  assert(empty.begin() == empty.end());
+  assert(empty.find(3) == empty.end());
+}
+
+void TestDurableMap() {
+  std::string path = "/tmp/unordered_map_journal_" + std::to_string(getpid());
+  std::remove(path.c_str());
+  std::remove((path + ".snapshot").c_str());
+  {
+    DurableMap<int, std::string> m(path);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+      writers.emplace_back([&m, t] {
+        for (int i = t; i < 400; i += 4) {
+          assert(m.insert(i, std::to_string(i)));
+        }
+      });
+    }
+    for (auto& writer : writers) {
+      writer.join();
+    }
+    assert(!m.insert(3, "again"));
+    assert(m.erase(7) == 1);
+    assert(m.erase(7) == 0);
+    m.insert_or_assign(5, "five");
+  }
+  {
+    DurableMap<int, std::string> m(path);
+    assert(m.size() == 399);
+    assert(*m.get(5) == "five");
+    assert(!m.contains(7));
+    m.compact();
+    m.insert_or_assign(1000, "thousand");
+    m.erase(0);
+  }
+  {
+    FILE* log = std::fopen(path.c_str(), "ab");
+    std::fputs("torn", log);
+    std::fclose(log);
+  }
+  {
+    DurableMap<int, std::string> m(path);
+    assert(m.size() == 399);
+    assert(*m.get(1000) == "thousand");
+    assert(!m.get(0));
+    m.insert_or_assign(-1, "after tear");
+  }
+  {
+    DurableMap<int, std::string> m(path);
+    assert(*m.get(-1) == "after tear");
+    assert(*m.get(399) == "399");
+  }
+  {
+    DurableMap<int, std::string> m(path);
+    ::close(m.fd);
+    m.fd = ::open("/dev/full", O_WRONLY | O_CLOEXEC);
+    try {
+      m.insert_or_assign(-1, "lost");
+      assert(false);
+    } catch (std::system_error&) {}
+    assert(*m.get(-1) == "after tear");
+    assert(!m.contains(2000));
+    try {
+      m.insert(2000, "refused");
+      assert(false);
+    } catch (std::runtime_error&) {}
+    assert(!m.contains(2000));
+  }
+  {
+    std::remove(path.c_str());
+    std::remove((path + ".snapshot").c_str());
+    DurableMap<int, int> m(path);
+    std::atomic<int> inserted{0};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+      writers.emplace_back([&m, &inserted] {
+        for (int i = 0; i < 200; ++i) {
+          inserted += m.insert(i, i);
+        }
+      });
+    }
+    for (auto& writer : writers) {
+      writer.join();
+    }
+    assert(inserted == 200);
+    assert(m.size() == 200);
+  }
+  std::remove(path.c_str());
+  std::remove((path + ".snapshot").c_str());
+}
+
+template<typename GrowthPolicy>
+void CheckReserveIsExact() {
+  UnorderedMap<int, int, DefaultHash<int>, std::equal_to<int>,
+               std::allocator<std::pair<const int, int>>, GrowthPolicy> m;
+  m.reserve(1000);
+  assert(m.capacity() >= 1000);
+  size_t buckets = m.bucket_count();
+  for (int i = 0; i < 1000; ++i) {
+    m.emplace(i, i);
+  }
+  assert(m.bucket_count() == buckets);
+  m.reserve(1000);
+  assert(m.bucket_count() == buckets);
+  m.emplace(1000, 1000);
+  assert(m.capacity() >= m.size());
+  for (int i = 0; i <= 1000; ++i) {
+    assert(m.at(i) == i);
+  }
+  m.rehash(1);
+  assert(m.capacity() >= m.size());
+  assert(m.at(500) == 500);
+}
+
+void TestGrowthPolicy() {
+  CheckReserveIsExact<DefaultGrowthPolicy>();
+  CheckReserveIsExact<PrimeGrowthPolicy>();
+  CheckReserveIsExact<PowerOfTwoGrowthPolicy>();
+  CheckReserveIsExact<FactorGrowthPolicy>();
+
+  UnorderedMap<int, int, DefaultHash<int>, std::equal_to<int>,
+               std::allocator<std::pair<const int, int>>, PowerOfTwoGrowthPolicy> pow2;
+  for (int i = 0; i < 5000; ++i) {
+    pow2[i] = i;
+    assert((pow2.bucket_count() & (pow2.bucket_count() - 1)) == 0);
+  }
+
+  UnorderedMap<int, int, DefaultHash<int>, std::equal_to<int>,
+               std::allocator<std::pair<const int, int>>, PrimeGrowthPolicy> prime(100);
+  assert(prime.bucket_count() == 131);
+  prime.reserve(100000);
+  assert(std::binary_search(std::begin(PrimeGrowthPolicy::kPrimes),
+                            std::end(PrimeGrowthPolicy::kPrimes), prime.bucket_count()));
+}
+
+void TestAdaptiveMap() {
+  using Map = AdaptiveUnorderedMap<int, int>;
+  Map m;
+  for (int i = 0; i < 8; ++i) {
+    m.emplace(i, i);
+  }
+  assert(m.layout() == Map::Layout::kLinear);
+  int* stable = &m.at(3);
+  m.emplace(8, 8);
+  assert(m.layout() == Map::Layout::kChained);
+  for (int i = 9; i < 5000; ++i) {
+    m[i] = i;
+  }
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 0; i < 5000; ++i) {
+      assert(m.find(i)->second == i);
+    }
+  }
+  m.emplace(5000, 5000);
+  assert(m.layout() == Map::Layout::kFlat);
+  assert(&m.at(3) == stable);
+  assert(m.size() == 5001);
+  assert(!m.contains(-1));
+
+  for (auto it = m.begin(); it != m.end();) {
+    it = it->first % 2 == 0 ? m.erase(it) : std::next(it);
+  }
+  assert(m.size() == 2500);
+  size_t seen = 0;
+  for (const auto& item : m) {
+    assert(item.first % 2 == 1 && item.second == item.first);
+    ++seen;
+  }
+  assert(seen == 2500);
+
+  for (int i = 0; i < 5000; ++i) {
+    m.erase(i * 2 + 1);
+    m.emplace(-i - 1, i);
+  }
+  assert(m.layout() == Map::Layout::kChained);
+  assert(m.size() == 5000);
+  for (int i = 0; i < 4997; ++i) {
+    m.erase(-i - 1);
+  }
+  assert(m.layout() == Map::Layout::kLinear);
+  assert(m.size() == 3);
+
+  Map copy = m;
+  assert(copy.at(-5000) == 4999);
+
+  struct Constant {
+    size_t operator()(int) const {
+      return 0;
+    }
+  };
+  AdaptiveUnorderedMap<int, int, Constant> clustered;
+  for (int i = 0; i < 1500; ++i) {
+    clustered.emplace(i, i);
+  }
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 1500; ++i) {
+      assert(clustered.at(i) == i);
+    }
+  }
+  clustered.emplace(1500, 1500);
+  assert(clustered.layout() != decltype(clustered)::Layout::kFlat);
+  assert(clustered.size() == 1501);
+
+  Map loaded;
+  for (int i = 0; i < 5000; ++i) {
+    loaded.emplace(i, i);
+  }
+  const Map& reader = loaded;
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 5000; ++i) {
+      assert(reader.at(i) == i);
+    }
+  }
+  assert(loaded.layout() == Map::Layout::kChained);
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 5000; ++i) {
+      assert(loaded.find(i)->second == i);
+    }
+  }
+  assert(loaded.layout() == Map::Layout::kFlat);
+}
+
+void TestAdaptiveMapBadAlloc() {
+  using Alloc = FailingAllocator<std::pair<const int, int>>;
+  using Map = AdaptiveUnorderedMap<int, int, std::hash<int>, std::equal_to<int>, Alloc>;
+  auto check = [](const Map& m, int count) {
+    assert(m.size() == static_cast<size_t>(count));
+    for (int i = 0; i < count; ++i) {
+      assert(m.at(i) == i);
+    }
+  };
+  for (long long limit = 0; limit < 32; ++limit) {
+    long long budget = -1;
+    Map m{Alloc(&budget)};
+    for (int i = 0; i < 8; ++i) {
+      m.emplace(i, i);
+    }
+    budget = limit;
+    try {
+      m.emplace(8, 8);
+    } catch (const std::bad_alloc&) {
+    }
+    budget = -1;
+    check(m, m.contains(8) ? 9 : 8);
+    m.emplace(8, 8);
+    m.emplace(9, 9);
+    check(m, 10);
+  }
+  for (long long limit = 0; limit < 8; ++limit) {
+    long long budget = -1;
+    Map m{Alloc(&budget)};
+    for (int i = 0; i < 1500; ++i) {
+      m.emplace(i, i);
+    }
+    for (int round = 0; round < 10; ++round) {
+      check(m, 1500);
+    }
+    budget = limit;
+    try {
+      m.emplace(1500, 1500);
+    } catch (const std::bad_alloc&) {
+    }
+    budget = -1;
+    check(m, m.contains(1500) ? 1501 : 1500);
+    m.emplace(1500, 1500);
+    check(m, 1501);
+  }
+}
+
+void TestUnorderedSet() {
+  UnorderedSet<std::string> words;
+  assert(words.insert("a").second);
+  assert(!words.insert("a").second);
+  std::vector<std::string> batch = {"b", "c", "d", "a"};
+  words.insert(batch.begin(), batch.end());
+  assert(words.size() == 4);
+  assert(words.contains("c") && !words.contains("z"));
+  std::vector<std::string> queries = {"a", "z", "d"};
+  std::vector<bool> found;
+  words.contains(queries.begin(), queries.end(), std::back_inserter(found));
+  assert((found == std::vector<bool>{true, false, true}));
+  assert(words.erase_keys(queries.begin(), queries.end()) == 2);
+  assert(words.size() == 2);
+  static_assert(sizeof(UnorderedSet<int>::NodeType) == sizeof(int));
+
+  UnorderedSet<int> evens;
+  UnorderedSet<int> threes;
+  evens.reserve(1000);
+  threes.reserve(1000);
+  for (int i = 0; i < 1000; ++i) {
+    evens.insert(i * 2);
+    threes.insert(i * 3);
+  }
+  assert(evens.shares_buckets(threes));
+  auto sixes = evens.intersection(threes);
+  assert(sixes.size() == 334);
+  for (int key : sixes) {
+    assert(key % 6 == 0);
+  }
+  assert(sixes.bucket_count() == evens.bucket_count());
+
+  std::vector<int> odd = {1, 3, 5};
+  UnorderedSet<int> few(odd.begin(), odd.end());
+  static_assert(!std::is_constructible_v<UnorderedSet<size_t>, int, int>);
+  assert(few.intersection(threes).size() == 1);
+
+  UnorderedSet<int> wide(1000);
+  UnorderedSet<int> narrow(1000);
+  for (int i = 0; i < 700; ++i) {
+    wide.insert(i);
+    narrow.insert(i);
+  }
+  wide.max_load_factor(0.1);
+  auto common = narrow.intersection(wide);
+  assert(common.size() == 700);
+  assert(common.size() <= common.capacity());
+
+  evens.merge(threes);
+  assert(evens.size() == 1000 + 1000 - 334);
+  for (int i = 0; i < 1000; ++i) {
+    assert(evens.contains(i * 2) && evens.contains(i * 3));
+  }
+  auto copy = evens;
+  copy.erase(copy.find(0));
+  assert(copy.size() + 1 == evens.size());
+}
+
+void TestHugePageAllocator() {
+  size_t regions_before = HugePageStats::mapped_regions;
+  size_t bytes_before = HugePageStats::mapped_bytes;
+  {
+    huge::UnorderedMap<int, int> m;
+    for (int i = 0; i < 200000; ++i) {
+      m.emplace(i, -i);
+    }
+    assert(HugePageStats::mapped_regions > regions_before);
+    assert(HugePageStats::advised + HugePageStats::fallbacks > 0);
+    auto bucket_array = reinterpret_cast<uintptr_t>(m.hash_array.data());
+    assert(bucket_array % huge_page_detail::kHugePageSize == 0);
+    assert(m.get_allocator().pool->slabs.size() > 0);
+    size_t backed = m.get_allocator().pool->huge_page_bytes();
+    assert(backed % huge_page_detail::kHugePageSize == 0);
+    assert(backed == 0 || HugePageStats::advised > 0);
+
+    auto copy = m;
+    assert(copy.get_allocator() != m.get_allocator());
+    for (int i = 0; i < 200000; ++i) {
+      assert(copy.at(i) == -i);
+    }
+    for (int i = 0; i < 100000; ++i) {
+      m.erase(i);
+    }
+    size_t slabs = m.get_allocator().pool->slabs.size();
+    for (int i = 0; i < 100000; ++i) {
+      m.emplace(i, i);
+    }
+    assert(m.get_allocator().pool->slabs.size() == slabs);
+
+    huge::UnorderedMap<int, int> moved = std::move(m);
+    assert(moved.size() == 200000);
+    assert(moved.get_allocator() != m.get_allocator());
+    std::thread writer([&m] {
+      for (int i = 0; i < 1000; ++i) {
+        m.emplace(i, i);
+      }
+    });
+    for (int i = 0; i < 1000; ++i) {
+      moved.erase(i);
+      moved.emplace(i, i);
+    }
+    writer.join();
+    assert(m.size() == 1000 && moved.size() == 200000);
+  }
+  assert(HugePageStats::mapped_regions == regions_before);
+  assert(HugePageStats::mapped_bytes == bytes_before);
+}
+
+void TestExpiringMap() {
+  ExpiringMap<std::string, int> m;
+  size_t expired = 0;
+  m.set_expiry_callback([&expired](const std::string&, int&) { ++expired; });
+  m.put("a", 10, 1);
+  m.put("b", 100, 2);
+  m.put("c", ExpiringMap<std::string, int>::kNever, 3);
+  m.put("d", 5000, 4);
+  assert(m.tick(9) == 0);
+  assert(*m.find("a") == 1);
+  assert(m.tick(10) == 1);
+  assert(m.find("a") == nullptr);
+  assert(m.size() == 3);
+  assert(m.find("b", 150) == nullptr && *m.find("b") == 2);
+  assert(m.expire_at("b", 20));
+  m.put("e", 5, 5);
+  assert(!m.contains("e"));
+  assert(m.tick(25) == 2);
+  assert(!m.contains("b"));
+  assert(m.erase("d"));
+  assert(m.tick(1'000'000) == 0);
+  assert(*m.find("c") == 3);
+  assert(expired == 3);
+
+  std::mt19937_64 generator(7);
+  ExpiringMap<int, int> wheel(1000);
+  std::map<int, uint64_t> deadlines;
+  for (int i = 0; i < 20000; ++i) {
+    uint64_t deadline = 1000 + generator() % (uint64_t(1) << (generator() % 40));
+    wheel.put(i, deadline, i);
+    deadlines[i] = deadline;
+  }
+  uint64_t now = 1000;
+  while (!deadlines.empty()) {
+    now += generator() % (uint64_t(1) << (generator() % 36));
+    size_t expected = 0;
+    for (auto it = deadlines.begin(); it != deadlines.end();) {
+      if (it->second <= now) {
+        it = deadlines.erase(it);
+        ++expected;
+      } else {
+        ++it;
+      }
+    }
+    assert(wheel.tick(now) == expected);
+    assert(wheel.size() == deadlines.size());
+    for (auto& [key, deadline] : deadlines) {
+      assert(*wheel.find(key) == key);
+    }
+  }
+}
+
+void TestBloomFilter() {
+  using Map = UnorderedMap<int, int, DefaultHash<int>, std::equal_to<int>,
+                           std::allocator<std::pair<const int, int>>,
+                           DefaultGrowthPolicy, BlockedBloomFilter>;
+  Map m;
+  for (int i = 0; i < 20000; i += 2) {
+    m[i] = i;
+  }
+  for (int i = 0; i < 20000; ++i) {
+    assert(m.contains(i) == (i % 2 == 0));
+    assert((m.find(i) != m.end()) == (i % 2 == 0));
+  }
+  assert(m.at(42) == 42);
+  try {
+    m.at(43);
+    assert(false);
+  } catch (std::out_of_range&) {}
+
+  size_t passed = 0;
+  for (int i = 1; i < 20000; i += 2) {
+    passed += m.filter.may_contain(DefaultHash<int>()(i));
+  }
+  assert(passed < 10000 / 20);
+
+  m.erase(42);
+  assert(!m.contains(42));
+  m.rehash(m.bucket_count() * 4);
+  Map copy = m;
+  for (int i = 0; i < 20000; i += 2) {
+    assert(copy.contains(i) == (i != 42));
+  }
+  copy.clear();
+  size_t stale = 0;
+  for (int i = 0; i < 20000; i += 2) {
+    stale += copy.filter.may_contain(DefaultHash<int>()(i));
+  }
+  assert(stale < 10000 / 20);
+  copy[7] = 7;
+  assert(copy.at(7) == 7);
+
+  Map churned;
+  for (int i = 0; i < 1000; ++i) {
+    churned[i] = i;
+  }
+  size_t buckets = churned.bucket_count();
+  for (int i = 1000; i < 200000; ++i) {
+    churned.erase(i - 1000);
+    churned[i] = i;
+  }
+  assert(churned.bucket_count() == buckets);
+  size_t churn_passed = 0;
+  for (int i = -1; i > -10001; --i) {
+    churn_passed += churned.filter.may_contain(DefaultHash<int>()(i));
+  }
+  assert(churn_passed < 10000 / 20);
+
+  static size_t calls = 0;
+  struct CountingHash {
+    size_t operator()(int key) const {
+      ++calls;
+      return std::hash<int>()(key);
+    }
+  };
+  UnorderedMap<int, int, CountingHash> counted;
+  counted.reserve(1000);
+  for (int i = 0; i < 500; ++i) {
+    counted.insert({i, i});
+    counted.emplace(i + 500, i);
+  }
+  assert(calls == 1000);
+
+  struct CountingSeededHash: CountingHash {
+    void reseed() {}
+  };
+  UnorderedMap<int, int, CountingSeededHash> seeded;
+  seeded.reserve(1000);
+  for (int i = 0; i < 1000; ++i) {
+    seeded.emplace(i, i);
+  }
+  assert(calls == 2000);
+}
+
+void TestPartition() {
+  UnorderedMap<int, int> m;
+  for (auto& range : m.partition(4)) {
+    assert(range.begin() == range.end());
+  }
+  const int kSize = 100000;
+  for (int i = 0; i < kSize; ++i) {
+    m[i * 7] = i;
+  }
+  auto ranges = m.partition(7);
+  assert(ranges.size() == 7);
+  std::vector<int> seen(kSize, 0);
+  for (auto& range : ranges) {
+    size_t count = 0;
+    for (auto& item : range) {
+      ++seen[item.second];
+      ++count;
+    }
+    assert(count > 0);
+  }
+  assert(std::count(seen.begin(), seen.end(), 1) == kSize);
+  UnorderedMap<int, int, FastHash<int>> spread;
+  for (int i = 0; i < kSize; ++i) {
+    spread[i] = i;
+  }
+  for (auto& range : spread.partition(7)) {
+    size_t count = std::distance(range.begin(), range.end());
+    assert(count > kSize / 7 * 9 / 10 && count < kSize / 7 * 11 / 10);
+  }
+  assert(m.partition(0).size() == 1);
+  assert(m.partition(m.bucket_count() + 5).size() == m.bucket_count());
+
+  std::atomic<long long> total{0};
+  m.parallel_for_each([&total](std::pair<const int, int>& item) {
+    ++item.second;
+    total += item.second;
+  }, 4);
+  assert(total == static_cast<long long>(kSize) * (kSize + 1) / 2);
+  const auto& view = m;
+  size_t visited = 0;
+  for (auto& range : view.partition(3)) {
+    for (auto& item : range) {
+      assert(item.second == item.first / 7 + 1);
+      ++visited;
+    }
+  }
+  assert(visited == static_cast<size_t>(kSize));
+
+  try {
+    m.parallel_for_each([](std::pair<const int, int>& item) {
+      if (item.first == 700) {
+        throw std::runtime_error("stop");
+      }
+    }, 3);
+    assert(false);
+  } catch (std::runtime_error&) {}
+}
+
 int main() {
- // SimpleTest();
-  //TestIterators();
-  //TestConstIteratorDoesntAllowModification(0);
-  //TestNoRedundantCopies();
-  //TestCustomHashAndCompare();
+  SimpleTest();
+  TestIterators();
+  TestConstIteratorDoesntAllowModification(0);
+  TestNoRedundantCopies();
+  TestCustomHashAndCompare();
   TestCustomAlloc();
+  TestSeededHash();
+  TestStringMap();
+  TestStatefulAllocator();
+  TestLruCache();
+  TestUnorderedMultiMap();
+  TestFastHash();
+  TestSnapshotMap();
+  TestDurableMap();
+  TestGrowthPolicy();
+  TestAdaptiveMap();
+  TestAdaptiveMapBadAlloc();
+  TestUnorderedSet();
+  TestHugePageAllocator();
+  TestExpiringMap();
+  TestBloomFilter();
+  TestPartition();
 }
\ No newline at end of file
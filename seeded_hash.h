@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string_view>
+#include <type_traits>
+
+
+namespace seeded_hash_detail {
+
+inline uint64_t rotl(uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+inline uint64_t load_u64(const unsigned char* p) {
+  uint64_t result;
+  std::memcpy(&result, p, sizeof(result));
+  return result;
+}
+
+// SipHash-1-3: one compression round per block, three finalization rounds.
+class SipState {
+  uint64_t v0, v1, v2, v3;
+
+  void round() {
+    v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+    v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+  }
+public:
+  SipState(uint64_t k0, uint64_t k1):
+      v0(k0 ^ 0x736f6d6570736575ULL),
+      v1(k1 ^ 0x646f72616e646f6dULL),
+      v2(k0 ^ 0x6c7967656e657261ULL),
+      v3(k1 ^ 0x7465646279746573ULL) {}
+
+  void block(uint64_t m) {
+    v3 ^= m;
+    round();
+    v0 ^= m;
+  }
+
+  uint64_t finish(uint64_t last) {
+    block(last);
+    v2 ^= 0xff;
+    round();
+    round();
+    round();
+    return v0 ^ v1 ^ v2 ^ v3;
+  }
+};
+
+inline uint64_t siphash(const void* data, size_t length, uint64_t k0, uint64_t k1) {
+  SipState state(k0, k1);
+  auto bytes = static_cast<const unsigned char*>(data);
+  size_t tail = length & 7;
+  const unsigned char* stop = bytes + (length - tail);
+  for (; bytes != stop; bytes += 8) {
+    state.block(load_u64(bytes));
+  }
+  uint64_t last = static_cast<uint64_t>(length) << 56;
+  for (size_t i = 0; i < tail; ++i) {
+    last |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+  }
+  return state.finish(last);
+}
+
+inline uint64_t siphash(uint64_t value, uint64_t k0, uint64_t k1) {
+  SipState state(k0, k1);
+  state.block(value);
+  return state.finish(static_cast<uint64_t>(8) << 56);
+}
+
+inline uint64_t random_seed() {
+  thread_local std::mt19937_64 generator(
+      (static_cast<uint64_t>(std::random_device()()) << 32) ^ std::random_device()()
+  );
+  return generator();
+}
+
+}  // namespace seeded_hash_detail
+
+
+// Keyed hash with a per-instance random seed. Integers and anything viewable
+// as std::string_view go through SipHash directly; other types are keyed on
+// top of std::hash, so they only resist collisions std::hash doesn't produce.
+// UnorderedMap calls reseed() and rehashes when a bucket chain grows too long.
+template<typename Key>
+class SeededHash {
+public:
+  uint64_t k0;
+  uint64_t k1;
+
+  SeededHash() {
+    reseed();
+  }
+
+  SeededHash(uint64_t k0, uint64_t k1): k0(k0), k1(k1) {}
+
+  void reseed() {
+    k0 = seeded_hash_detail::random_seed();
+    k1 = seeded_hash_detail::random_seed();
+  }
+
+  size_t operator()(const Key& key) const {
+    if constexpr (std::is_integral_v<Key> || std::is_enum_v<Key>) {
+      return seeded_hash_detail::siphash(static_cast<uint64_t>(key), k0, k1);
+    } else if constexpr (std::is_convertible_v<const Key&, std::string_view>) {
+      std::string_view view = key;
+      return seeded_hash_detail::siphash(view.data(), view.size(), k0, k1);
+    } else {
+      return seeded_hash_detail::siphash(
+          static_cast<uint64_t>(std::hash<Key>()(key)), k0, k1
+      );
+    }
+  }
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include "unordered_map.h"
+
+
+// Copy-on-write map: copying shares a reference-counted table of segments,
+// so a snapshot costs one refcount increment. The first write to a shared
+// map clones the 64-pointer table and then only the segment it touches.
+// Different instances may be used from different threads; a single
+// instance has one writer. Writes go through insert_or_assign, emplace or
+// erase, which unshare first; values are read back through const at() and
+// find(), and there is no operator[] whose reference could outlive a
+// snapshot.
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>
+>
+class SnapshotMap {
+public:
+  static constexpr size_t kSegmentBits = 6;
+  static constexpr size_t kSegmentCount = size_t(1) << kSegmentBits;
+
+  using Segment = UnorderedMap<Key, Value, Hash, Equal>;
+  using NodeType = typename Segment::NodeType;
+  using Table = std::array<std::shared_ptr<Segment>, kSegmentCount>;
+
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const NodeType*;
+    using reference = const NodeType&;
+    using segment_iterator = typename Segment::const_iterator;
+
+    const Table* table;
+    size_t segment;
+    std::optional<segment_iterator> it;
+
+    const_iterator(const Table* table, size_t segment, std::optional<segment_iterator> it):
+        table(table), segment(segment), it(it) {
+      skip_empty();
+    }
+
+    void skip_empty() {
+      while (segment < kSegmentCount) {
+        const auto& current = (*table)[segment];
+        if (current && !it) {
+          it = current->cbegin();
+        }
+        if (it && *it != current->cend()) {
+          return;
+        }
+        ++segment;
+        it.reset();
+      }
+    }
+
+    reference operator*() const {
+      return **it;
+    }
+
+    pointer operator->() const {
+      return &**it;
+    }
+
+    const_iterator& operator++() {
+      ++*it;
+      skip_empty();
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const const_iterator& other) const {
+      return segment == other.segment && it == other.it;
+    }
+
+    bool operator!=(const const_iterator& other) const {
+      return !(*this == other);
+    }
+  };
+
+  using iterator = const_iterator;
+
+  std::shared_ptr<Table> table;
+  Hash hash_function;
+  size_t length = 0;
+
+  SnapshotMap(): table(std::make_shared<Table>()) {}
+
+  SnapshotMap snapshot() const {
+    return *this;
+  }
+
+  size_t size() const {
+    return length;
+  }
+
+  size_t segment_of(const Key& key) const {
+    return (hash_function(key) * 0x9e3779b97f4a7c15ULL) >> (64 - kSegmentBits);
+  }
+
+  const Segment* segment(size_t index) const {
+    return (*table)[index].get();
+  }
+
+  // Unshares the table and the one segment a write is about to touch.
+  // use_count() is a relaxed load; seeing 1 means every other owner has
+  // released its copy, and the acquire fence orders that release before
+  // our in-place writes.
+  Segment& detach(size_t index) {
+    if (table.use_count() > 1) {
+      table = std::make_shared<Table>(*table);
+    }
+    std::shared_ptr<Segment>& current = (*table)[index];
+    if (!current) {
+      current = std::make_shared<Segment>();
+    } else if (current.use_count() > 1) {
+      current = std::make_shared<Segment>(*current);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return *current;
+  }
+
+  const_iterator find(const Key& key) const {
+    size_t index = segment_of(key);
+    const Segment* current = segment(index);
+    if (current == nullptr) {
+      return end();
+    }
+    auto it = current->find(key);
+    if (it == current->cend()) {
+      return end();
+    }
+    return const_iterator(table.get(), index, it);
+  }
+
+  size_t count(const Key& key) const {
+    return find(key) != end() ? 1 : 0;
+  }
+
+  const Value& at(const Key& key) const {
+    const_iterator it = find(key);
+    if (it == end()) {
+      throw std::out_of_range("Target element doesn't exists");
+    }
+    return it->second;
+  }
+
+  template<typename... Args>
+  bool emplace(const Key& key, Args&&... args) {
+    if (find(key) != end()) {
+      return false;
+    }
+    detach(segment_of(key)).emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(key),
+        std::forward_as_tuple(std::forward<Args>(args)...)
+    );
+    ++length;
+    return true;
+  }
+
+  bool insert(const NodeType& value) {
+    return emplace(value.first, value.second);
+  }
+
+  // Inserts `key` or overwrites its value; snapshots keep the old one.
+  template<typename... Args>
+  bool insert_or_assign(const Key& key, Args&&... args) {
+    Segment& current = detach(segment_of(key));
+    auto it = current.find(key);
+    if (it != current.end()) {
+      it->second = Value(std::forward<Args>(args)...);
+      return false;
+    }
+    current.emplace(
+        std::piecewise_construct,
+        std::forward_as_tuple(key),
+        std::forward_as_tuple(std::forward<Args>(args)...)
+    );
+    ++length;
+    return true;
+  }
+
+  size_t erase(const Key& key) {
+    if (find(key) == end()) {
+      return 0;
+    }
+    detach(segment_of(key)).erase(key);
+    --length;
+    return 1;
+  }
+
+  const_iterator begin() const {
+    return const_iterator(table.get(), 0, std::nullopt);
+  }
+
+  const_iterator end() const {
+    return const_iterator(table.get(), kSegmentCount, std::nullopt);
+  }
+
+  const_iterator cbegin() const {
+    return begin();
+  }
+
+  const_iterator cend() const {
+    return end();
+  }
+};
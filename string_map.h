@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include "unordered_map.h"
+
+
+class StringArena {
+  std::vector<std::unique_ptr<char[]>> chunks;
+  char* cursor = nullptr;
+  size_t left = 0;
+  size_t chunk_size;
+  size_t used = 0;
+  size_t reserved = 0;
+public:
+  explicit StringArena(size_t chunk_size = 64 * 1024): chunk_size(chunk_size) {}
+
+  StringArena(const StringArena&) = delete;
+  StringArena& operator=(const StringArena&) = delete;
+
+  // The source forgets its bump region, which now belongs to this arena,
+  // so a later store() into it cannot overwrite keys it no longer owns.
+  StringArena(StringArena&& other):
+      chunks(std::move(other.chunks)),
+      cursor(std::exchange(other.cursor, nullptr)),
+      left(std::exchange(other.left, 0)),
+      chunk_size(other.chunk_size),
+      used(std::exchange(other.used, 0)),
+      reserved(std::exchange(other.reserved, 0)) {}
+
+  StringArena& operator=(StringArena&& other) {
+    if (this != &other) {
+      chunks = std::move(other.chunks);
+      other.chunks.clear();
+      cursor = std::exchange(other.cursor, nullptr);
+      left = std::exchange(other.left, 0);
+      chunk_size = other.chunk_size;
+      used = std::exchange(other.used, 0);
+      reserved = std::exchange(other.reserved, 0);
+    }
+    return *this;
+  }
+
+  const char* store(std::string_view bytes) {
+    used += bytes.size();
+    if (bytes.size() > chunk_size) {
+      chunks.emplace_back(new char[bytes.size()]);
+      reserved += bytes.size();
+      std::memcpy(chunks.back().get(), bytes.data(), bytes.size());
+      return chunks.back().get();
+    }
+    if (bytes.size() > left) {
+      chunks.emplace_back(new char[chunk_size]);
+      reserved += chunk_size;
+      cursor = chunks.back().get();
+      left = chunk_size;
+    }
+    char* result = cursor;
+    std::memcpy(result, bytes.data(), bytes.size());
+    cursor += bytes.size();
+    left -= bytes.size();
+    return result;
+  }
+
+  size_t bytes_used() const {
+    return used;
+  }
+
+  size_t bytes_reserved() const {
+    return reserved;
+  }
+};
+
+// Keys up to kInlineCapacity bytes live inside the key itself; longer ones
+// point into the owning map's arena (or, for lookup probes, at the caller's
+// bytes). The full hash is cached so rehashing never touches key bytes.
+class StringKey {
+public:
+  static constexpr size_t kInlineCapacity = 20;
+
+  size_t hash;
+  uint32_t length;
+  char bytes[kInlineCapacity];
+
+  StringKey(std::string_view view, size_t hash): hash(hash), length(view.size()) {
+    if (is_inline()) {
+      std::memcpy(bytes, view.data(), view.size());
+    } else {
+      const char* data = view.data();
+      std::memcpy(bytes, &data, sizeof(data));
+    }
+  }
+
+  bool is_inline() const {
+    return length <= kInlineCapacity;
+  }
+
+  const char* data() const {
+    if (is_inline()) {
+      return bytes;
+    }
+    const char* result;
+    std::memcpy(&result, bytes, sizeof(result));
+    return result;
+  }
+
+  std::string_view view() const {
+    return std::string_view(data(), length);
+  }
+};
+
+struct StringKeyHash {
+  size_t operator()(const StringKey& key) const {
+    return key.hash;
+  }
+};
+
+struct StringKeyEqual {
+  bool operator()(const StringKey& x, const StringKey& y) const {
+    return x.length == y.length && x.hash == y.hash &&
+        std::memcmp(x.data(), y.data(), x.length) == 0;
+  }
+};
+
+template<
+    typename Value,
+    typename Hash = std::hash<std::string_view>
+>
+class StringMap {
+public:
+  using Map = UnorderedMap<StringKey, Value, StringKeyHash, StringKeyEqual>;
+  using NodeType = typename Map::NodeType;
+  using iterator = typename Map::iterator;
+  using const_iterator = typename Map::const_iterator;
+  using AllocatorTraits = typename Map::AllocatorTraits;
+
+  Hash hash_function;
+  StringArena arena;
+  Map map;
+
+  StringMap() = default;
+
+  StringMap(const StringMap& other): hash_function(other.hash_function) {
+    map.max_load_factor(other.map.current_max_load_factor);
+    map.reserve(other.size());
+    for (auto it = other.cbegin(); it != other.cend(); ++it) {
+      map.emplace(own(it->first), it->second);
+    }
+  }
+
+  StringMap(StringMap&& other) = default;
+
+  StringMap& operator=(const StringMap& other) {
+    if (this == &other) {
+      return *this;
+    }
+    StringMap copy = other;
+    *this = std::move(copy);
+    return *this;
+  }
+
+  StringMap& operator=(StringMap&& other) = default;
+
+  StringKey probe(std::string_view key) const {
+    return StringKey(key, hash_function(key));
+  }
+
+  StringKey own(const StringKey& key) {
+    if (key.is_inline()) {
+      return key;
+    }
+    return StringKey(std::string_view(arena.store(key.view()), key.length), key.hash);
+  }
+
+  size_t size() const {
+    return map.size();
+  }
+
+  iterator find(std::string_view key) {
+    return map.find(probe(key));
+  }
+
+  Value& at(std::string_view key) {
+    return map.at(probe(key));
+  }
+
+  // One probe: the node is linked into the bucket the miss was found in.
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(std::string_view key, Args&&... args) {
+    StringKey lookup = probe(key);
+    size_t chain = 0;
+    iterator it = map.find_in_bucket(lookup, map.get_hash(lookup), chain);
+    if (it != map.end()) {
+      return {it, false};
+    }
+    size_t bucket = map.prepare_link(lookup, lookup.hash, chain);
+    NodeType* node = AllocatorTraits::allocate(map.t_alloc, 1);
+    try {
+      AllocatorTraits::construct(
+          map.t_alloc, node,
+          std::piecewise_construct,
+          std::forward_as_tuple(own(lookup)),
+          std::forward_as_tuple(std::forward<Args>(args)...)
+      );
+    } catch (...) {
+      AllocatorTraits::deallocate(map.t_alloc, node, 1);
+      throw;
+    }
+    return {map.link(bucket, node), true};
+  }
+
+  std::pair<iterator, bool> insert(std::string_view key, const Value& value) {
+    return emplace(key, value);
+  }
+
+  Value& operator[](std::string_view key) {
+    return emplace(key).first->second;
+  }
+
+  // Arena bytes of erased keys are reclaimed only when the map is destroyed.
+  size_t erase(std::string_view key) {
+    return map.erase(probe(key));
+  }
+
+  iterator erase(const_iterator it) {
+    return map.erase(it);
+  }
+
+  iterator begin() {
+    return map.begin();
+  }
+
+  const_iterator begin() const {
+    return map.begin();
+  }
+
+  iterator end() {
+    return map.end();
+  }
+
+  const_iterator end() const {
+    return map.end();
+  }
+
+  const_iterator cbegin() const {
+    return map.cbegin();
+  }
+
+  const_iterator cend() const {
+    return map.cend();
+  }
+};
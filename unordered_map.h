@@ -1,8 +1,20 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <exception>
 #include <list>
+#include <memory>
+#include <memory_resource>
+#include <thread>
 #include <vector>
 #include <type_traits>
 #include <iostream>
 
+#ifdef UNORDERED_MAP_FAST_HASH
+#include "fast_hash.h"
+#endif
+
 
 template<typename T, typename Allocator = std::allocator<T>>
 class List {
@@ -18,7 +30,7 @@ class List {
 
   Node* head;
   size_t length;
-  using NAllocator = typename Allocator::template rebind<Node>::other;
+  using NAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
   NAllocator allocator;
   Allocator t_allocator;
 public:
@@ -46,15 +58,15 @@ public:
     return result;
   }
 
+public:
+  // Exchanges contents but not allocators; both lists must share one.
   void no_allocator_swap(List& other) {
     std::swap(length, other.length);
     std::swap(head, other.head);
   }
-public:
+
   explicit List(const Allocator& t_allocator = Allocator()):
-      length(0), t_allocator(t_allocator) {
-    typename Allocator::template rebind<Node>::other n_allocator;
-    allocator = n_allocator;
+      length(0), allocator(t_allocator), t_allocator(t_allocator) {
     head = std::allocator_traits<NAllocator>::allocate(allocator, 1);
     head->next = head;
     head->prev = head;
@@ -64,9 +76,7 @@ public:
       size_t count,
       const T& value,
       const Allocator& t_allocator = Allocator()):
-      length(count), t_allocator(t_allocator) {
-    typename Allocator::template rebind<Node>::other n_allocator;
-    allocator = n_allocator;
+      length(count), allocator(t_allocator), t_allocator(t_allocator) {
     head = std::allocator_traits<NAllocator>::allocate(allocator, 1);
     head->next = head;
     head->prev = head;
@@ -86,9 +96,7 @@ public:
   explicit List(
       size_t count,
       const Allocator& t_allocator = Allocator()):
-      length(count), t_allocator(t_allocator) {
-    typename Allocator::template rebind<Node>::other n_allocator;
-    allocator = n_allocator;
+      length(count), allocator(t_allocator), t_allocator(t_allocator) {
     head = std::allocator_traits<NAllocator>::allocate(allocator, 1);
     head->next = head;
     head->prev = head;
@@ -105,11 +113,12 @@ public:
     head->prev = copy_after;
   }
 
-  List(const List& other): length(other.length) {
-    t_allocator = std::allocator_traits<Allocator>::
-    select_on_container_copy_construction(other.t_allocator);
-    allocator = std::allocator_traits<NAllocator>::
-    select_on_container_copy_construction(other.allocator);
+  List(const List& other):
+      List(other, std::allocator_traits<Allocator>::
+      select_on_container_copy_construction(other.t_allocator)) {}
+
+  List(const List& other, const Allocator& t_allocator):
+      length(other.length), allocator(t_allocator), t_allocator(t_allocator) {
     head = std::allocator_traits<NAllocator>::allocate(allocator, 1);
     head->next = head;
     head->prev = head;
@@ -135,10 +144,12 @@ public:
     }
   }
 
-  List(List&& other) noexcept : length(other.length) {
-    t_allocator = std::move(other.t_allocator);
-    allocator = std::move(other.allocator);
-    auto new_head = std::allocator_traits<NAllocator>::allocate(allocator, 1);
+  List(List&& other) noexcept:
+      length(other.length),
+      allocator(std::move(other.allocator)),
+      t_allocator(std::move(other.t_allocator)) {
+    // The source frees its new head itself, so it comes from its allocator.
+    auto new_head = std::allocator_traits<NAllocator>::allocate(other.allocator, 1);
     new_head->next = new_head;
     new_head->prev = new_head;
     other.length = 0;
@@ -150,27 +161,41 @@ public:
     if (this == &other) {
       return *this;
     }
-    List copy = other;
-    if (std::allocator_traits<Allocator>::
+    if constexpr (std::allocator_traits<Allocator>::
     propagate_on_container_copy_assignment::value) {
-      t_allocator = other.t_allocator;
-      allocator = other.allocator;
+      List copy(other, other.t_allocator);
+      no_allocator_swap(copy);
+      std::swap(t_allocator, copy.t_allocator);
+      std::swap(allocator, copy.allocator);
+    } else {
+      List copy(other, t_allocator);
+      no_allocator_swap(copy);
     }
-    no_allocator_swap(copy);
     return *this;
   }
 
-  List& operator=(List&& other) noexcept {
+  // Unequal allocators that do not propagate force an element-wise copy,
+  // which may throw.
+  List& operator=(List&& other) noexcept(
+      std::allocator_traits<Allocator>::propagate_on_container_move_assignment::value ||
+      std::allocator_traits<Allocator>::is_always_equal::value) {
     if (this == &other) {
       return *this;
     }
-    List copy = std::move(other);
-    if (std::allocator_traits<Allocator>::
+    if constexpr (std::allocator_traits<Allocator>::
     propagate_on_container_move_assignment::value) {
-      t_allocator = std::move(other.t_allocator);
-      allocator = std::move(other.allocator);
+      List copy = std::move(other);
+      no_allocator_swap(copy);
+      std::swap(t_allocator, copy.t_allocator);
+      std::swap(allocator, copy.allocator);
+    } else if (std::allocator_traits<Allocator>::is_always_equal::value ||
+        allocator == other.allocator) {
+      List copy = std::move(other);
+      no_allocator_swap(copy);
+    } else {
+      List copy(other, t_allocator);
+      no_allocator_swap(copy);
     }
-    no_allocator_swap(copy);
     return *this;
   }
 
@@ -237,7 +262,7 @@ public:
 
     iterator_impl operator--(int) {
       auto copy = *this;
-      it = it->prev();
+      it = it->prev;
       return copy;
     }
 
@@ -285,7 +310,7 @@ public:
   }
 
   const_iterator cend() const {
-    const_iterator it(head->next);
+    const_iterator it(head);
     return it;
   }
 
@@ -322,20 +347,242 @@ public:
   iterator erase(const_iterator it) {
     return iterator(erase(const_cast<Node*>(it.it)));
   }
+
+  // Moves `it` out of `other` to just before `pos` without allocating; both
+  // lists must share an allocator.
+  iterator splice(const_iterator pos, List& other, const_iterator it) {
+    Node* node = const_cast<Node*>(it.it);
+    Node* next = const_cast<Node*>(pos.it);
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    --other.length;
+    node->next = next;
+    node->prev = next->prev;
+    next->prev->next = node;
+    next->prev = node;
+    ++length;
+    return iterator(node);
+  }
 };
 
+#ifdef UNORDERED_MAP_FAST_HASH
+template<typename Key>
+using DefaultHash = FastHash<Key>;
+#else
+template<typename Key>
+using DefaultHash = std::hash<Key>;
+#endif
+
+// Growth policies decide which bucket counts are valid, how the table grows
+// once capacity() is exhausted, and how a hash is reduced to a bucket.
+struct DefaultGrowthPolicy {
+  static size_t bucket_count(size_t minimum) {
+    return minimum;
+  }
+
+  static size_t next(size_t current) {
+    return current * 2 + 1;
+  }
+
+  static size_t index(size_t hash, size_t count) {
+    return hash % count;
+  }
+};
+
+struct PrimeGrowthPolicy {
+  static constexpr uint64_t kPrimes[] = {
+    3ULL, 5ULL, 11ULL, 17ULL, 37ULL, 67ULL, 131ULL, 257ULL, 521ULL, 1031ULL, 2053ULL,
+    4099ULL, 8209ULL, 16411ULL, 32771ULL, 65537ULL, 131101ULL, 262147ULL, 524309ULL,
+    1048583ULL, 2097169ULL, 4194319ULL, 8388617ULL, 16777259ULL, 33554467ULL,
+    67108879ULL, 134217757ULL, 268435459ULL, 536870923ULL, 1073741827ULL, 2147483659ULL,
+    4294967311ULL, 8589934609ULL, 17179869209ULL, 34359738421ULL, 68719476767ULL,
+    137438953481ULL, 274877906951ULL, 549755813911ULL, 1099511627791ULL,
+    2199023255579ULL, 4398046511119ULL, 8796093022237ULL, 17592186044423ULL,
+    35184372088891ULL, 70368744177679ULL, 140737488355333ULL, 281474976710677ULL,
+    562949953421381ULL, 1125899906842679ULL, 2251799813685269ULL, 4503599627370517ULL,
+    9007199254740997ULL, 18014398509482143ULL, 36028797018963971ULL,
+    72057594037928017ULL, 144115188075855881ULL, 288230376151711813ULL,
+    576460752303423619ULL, 1152921504606847009ULL, 2305843009213693967ULL,
+    4611686018427388039ULL, 9223372036854775837ULL
+  };
+
+  static size_t bucket_count(size_t minimum) {
+    return *std::lower_bound(std::begin(kPrimes), std::end(kPrimes) - 1, minimum);
+  }
+
+  static size_t next(size_t current) {
+    return bucket_count(current * 2);
+  }
+
+  static size_t index(size_t hash, size_t count) {
+    return hash % count;
+  }
+};
+
+// Masks instead of dividing; pair it with a hash whose low bits are mixed.
+struct PowerOfTwoGrowthPolicy {
+  static size_t bucket_count(size_t minimum) {
+    size_t result = 1;
+    while (result < minimum) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  static size_t next(size_t current) {
+    return current * 2;
+  }
+
+  static size_t index(size_t hash, size_t count) {
+    return hash & (count - 1);
+  }
+};
+
+// Grows by 1.5x: less memory overshoot than doubling, more rehashes.
+struct FactorGrowthPolicy {
+  static size_t bucket_count(size_t minimum) {
+    return minimum;
+  }
+
+  static size_t next(size_t current) {
+    return current + current / 2 + 1;
+  }
+
+  static size_t index(size_t hash, size_t count) {
+    return hash % count;
+  }
+};
+
+template<typename Hash, typename = void>
+struct has_reseed: std::false_type {};
+
+template<typename Hash>
+struct has_reseed<Hash, std::void_t<decltype(std::declval<Hash&>().reseed())>>:
+    std::true_type {};
+
+// Lookup filters sit in front of the buckets and may answer "absent"
+// without walking a chain. They see the full hash of every linked key and
+// are rebuilt, sized for the new capacity, on each rehash and whenever
+// saturated() reports that erased keys have left too many stale bits.
+struct NoFilter {
+  void reset(size_t) {}
+
+  void add(size_t) {}
+
+  bool saturated() const {
+    return false;
+  }
+
+  bool may_contain(size_t) const {
+    return true;
+  }
+};
+
+// Split-block Bloom filter: a key sets one bit in each of the eight words of
+// a single 64-byte block, so a check reads one cache line. Bits are never
+// cleared; erased keys linger as false positives until the next rebuild,
+// which the table triggers once twice the sized-for capacity has been added.
+class BlockedBloomFilter {
+public:
+  static constexpr size_t kBitsPerElement = 12;
+  static constexpr size_t kBlockBits = 512;
+  static constexpr uint32_t kSalts[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+  };
+
+  struct alignas(64) Block {
+    uint64_t words[8];
+  };
+
+  std::vector<Block> blocks = std::vector<Block>(1);
+  size_t sized_for = 0;
+  size_t added = 0;
+
+  // The table's hash may be the identity, so it is remixed before its bits
+  // pick a block and the positions inside it.
+  static uint64_t mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    return hash ^ (hash >> 33);
+  }
+
+  static uint64_t bit(uint64_t mixed, int word) {
+    return uint64_t(1) << ((static_cast<uint32_t>(mixed) * kSalts[word]) >> 26);
+  }
+
+  const Block& block_of(uint64_t mixed) const {
+    return blocks[((mixed >> 32) * blocks.size()) >> 32];
+  }
+
+  void reset(size_t capacity) {
+    blocks.assign(capacity * kBitsPerElement / kBlockBits + 1, Block{});
+    sized_for = capacity;
+    added = 0;
+  }
+
+  bool saturated() const {
+    return added > 2 * std::max<size_t>(sized_for, 1);
+  }
+
+  void add(size_t hash) {
+    ++added;
+    uint64_t mixed = mix(hash);
+    Block& block = const_cast<Block&>(block_of(mixed));
+    for (int word = 0; word < 8; ++word) {
+      block.words[word] |= bit(mixed, word);
+    }
+  }
+
+  bool may_contain(size_t hash) const {
+    uint64_t mixed = mix(hash);
+    const Block& block = block_of(mixed);
+    uint64_t missing = 0;
+    for (int word = 0; word < 8; ++word) {
+      missing |= bit(mixed, word) & ~block.words[word];
+    }
+    return missing == 0;
+  }
+};
+
+// Key extraction for the engine: maps store pairs, sets store bare keys.
+struct PairKey {
+  template<typename Pair>
+  const auto& operator()(const Pair& value) const {
+    return value.first;
+  }
+};
+
+struct IdentityKey {
+  template<typename Key>
+  const Key& operator()(const Key& value) const {
+    return value;
+  }
+};
+
+// Bucket/list engine shared by UnorderedMap and UnorderedSet: Node is what
+// each element allocates and KeyOf reads the key out of it.
 template<
     typename Key,
-    typename Value,
-    typename Hash = std::hash<Key>,
-    typename Equal = std::equal_to<Key>,
-    typename Allocator = std::allocator<std::pair<const Key, Value>>
+    typename Node,
+    typename KeyOf,
+    typename Hash,
+    typename Equal,
+    typename Allocator,
+    typename GrowthPolicy,
+    typename Filter = NoFilter
 >
-class UnorderedMap {
+class HashTable {
 public:
-  using NodeType = std::pair<const Key, Value>;
-  using ListIterator = typename List<NodeType*>::iterator;
-  using ConstListIterator = typename List<NodeType*>::const_iterator;
+  using NodeType = Node;
+  using AllocatorTraits = std::allocator_traits<Allocator>;
+  using ElementList = List<NodeType*, typename AllocatorTraits::template rebind_alloc<NodeType*>>;
+  using ListIterator = typename ElementList::iterator;
+  using ConstListIterator = typename ElementList::const_iterator;
+  using BucketArray =
+  std::vector<ListIterator, typename AllocatorTraits::template rebind_alloc<ListIterator>>;
   template<bool IsConst>
   class iterator_impl {
   public:
@@ -395,84 +642,238 @@ public:
   using iterator = iterator_impl<false>;
   using const_iterator = iterator_impl<true>;
 
-  std::vector<ListIterator> hash_array;
+  // Walks the buckets [bucket, last) run by run. Runs of different buckets
+  // need not be adjacent in `elements`, so each one is entered through its
+  // bucket head and left when the bucket index of the next node changes.
+  template<bool IsConst>
+  class bucket_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeType;
+    using difference_type = size_t;
+    using pointer = typename std::conditional_t<IsConst, const NodeType*, NodeType*>;
+    using reference = typename std::conditional_t<IsConst, const NodeType&, NodeType&>;
+
+    HashTable* table;
+    size_t bucket;
+    size_t last;
+    ListIterator it;
+
+    bucket_iterator(HashTable* table, size_t bucket, size_t last):
+        table(table), bucket(bucket), last(last), it(table->elements.end()) {
+      seek();
+    }
+
+    void seek() {
+      while (bucket < last && table->hash_array[bucket] == table->elements.end()) {
+        ++bucket;
+      }
+      if (bucket < last) {
+        it = table->hash_array[bucket];
+      }
+    }
+
+    reference operator*() const {
+      return **it;
+    }
+
+    pointer operator->() const {
+      return *it;
+    }
+
+    bucket_iterator& operator++() {
+      ++it;
+      if (it == table->elements.end() || table->get_hash(key_of(**it)) != bucket) {
+        ++bucket;
+        seek();
+      }
+      return *this;
+    }
+
+    bucket_iterator operator++(int) {
+      auto copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const bucket_iterator& other) const {
+      return bucket == other.bucket && (bucket == last || it == other.it);
+    }
+
+    bool operator!=(const bucket_iterator& other) const {
+      return !(*this == other);
+    }
+  };
+
+  template<bool IsConst>
+  class bucket_range {
+  public:
+    bucket_iterator<IsConst> first;
+    bucket_iterator<IsConst> last;
+
+    bucket_iterator<IsConst> begin() const {
+      return first;
+    }
+
+    bucket_iterator<IsConst> end() const {
+      return last;
+    }
+  };
+
+  BucketArray hash_array;
   Hash hash_function;
-  //using Alloc = typename Allocator::template rebind<NodeType*>::other;
   Allocator t_alloc;
-  List<NodeType*> elements;
+  ElementList elements;
   Equal equal_key;
+  Filter filter;
 
 
   float current_max_load_factor = 0.75;
-
-  UnorderedMap() {
-    hash_array.resize(1, elements.end());
+  size_t current_max_chain_length = 32;
+  size_t next_reseed_size = 0;
+
+  HashTable(): HashTable(Allocator()) {}
+
+  explicit HashTable(const Allocator& alloc):
+      HashTable(1, Hash(), Equal(), alloc) {}
+
+  explicit HashTable(
+      size_t bucket_count,
+      const Hash& hash = Hash(),
+      const Equal& equal = Equal(),
+      const Allocator& alloc = Allocator()):
+      hash_array(alloc),
+      hash_function(hash),
+      t_alloc(alloc),
+      elements(alloc),
+      equal_key(equal) {
+    hash_array.resize(GrowthPolicy::bucket_count(std::max<size_t>(bucket_count, 1)), elements.end());
+    filter.reset(capacity());
   }
 
-  UnorderedMap(const UnorderedMap& other):
+  HashTable(const HashTable& other):
+      HashTable(other, AllocatorTraits::select_on_container_copy_construction(other.t_alloc)) {}
+
+  HashTable(const HashTable& other, const Allocator& alloc):
+      hash_array(alloc),
       hash_function(other.hash_function),
-      t_alloc(
-          std::allocator_traits<Allocator>::select_on_container_copy_construction(other.t_alloc)
-      ),
+      t_alloc(alloc),
+      elements(alloc),
       equal_key(other.equal_key),
-      current_max_load_factor(other.current_max_load_factor) {
-    hash_array.resize(1, elements.end());
-    for (auto it : other) {
-      insert(it);
+      current_max_load_factor(other.current_max_load_factor),
+      current_max_chain_length(other.current_max_chain_length),
+      next_reseed_size(other.next_reseed_size) {
+    hash_array.resize(bucket_count_for(other.size()), elements.end());
+    filter.reset(capacity());
+    for (const NodeType& item : other) {
+      insert(item);
     }
   }
 
-  UnorderedMap(UnorderedMap&& other):
+  HashTable(HashTable&& other):
       hash_array(std::move(other.hash_array)),
       hash_function(std::move(other.hash_function)),
       t_alloc(std::move(other.t_alloc)),
       elements(std::move(other.elements)),
       equal_key(std::move(other.equal_key)),
-      current_max_load_factor(std::move(other.current_max_load_factor))
-  {}
+      filter(std::move(other.filter)),
+      current_max_load_factor(std::move(other.current_max_load_factor)),
+      current_max_chain_length(other.current_max_chain_length),
+      next_reseed_size(other.next_reseed_size) {
+    other.reset_moved_from();
+  }
+
+  // A moved-from table keeps one empty bucket so it stays usable.
+  void reset_moved_from() {
+    hash_array.assign(1, elements.end());
+    filter.reset(capacity());
+  }
 
   void clear_list_elements() {
     if (elements.size() == 0) return;
     for (iterator it = elements.begin(); it != elements.end(); ++it) {
-      std::allocator_traits<Allocator>::destroy(t_alloc, &(*it));
-      std::allocator_traits<Allocator>::deallocate(t_alloc, &(*it), 1);
+      AllocatorTraits::destroy(t_alloc, &(*it));
+      AllocatorTraits::deallocate(t_alloc, &(*it), 1);
     }
     elements.clear();
   }
 
-  void swap_and_kill(UnorderedMap&& other) {
+  void clear() {
+    clear_list_elements();
+    hash_array.assign(hash_array.size(), elements.end());
+    filter.reset(capacity());
+  }
+
+  Allocator get_allocator() const {
+    return t_alloc;
+  }
+
+  void swap_and_kill(HashTable&& other) {
     hash_array = std::move(other.hash_array);
     hash_function = std::move(other.hash_function);
     clear_list_elements();
     elements = std::move(other.elements);
     equal_key = std::move(other.equal_key);
+    filter = std::move(other.filter);
     current_max_load_factor = std::move(other.current_max_load_factor);
+    current_max_chain_length = other.current_max_chain_length;
+    next_reseed_size = other.next_reseed_size;
+    other.reset_moved_from();
   }
 
-  UnorderedMap& operator=(const UnorderedMap& other) {
+  HashTable& operator=(const HashTable& other) {
     if (this == &other) {
       return *this;
     }
-    UnorderedMap copy = other;
-    if (std::allocator_traits<Allocator>::propagate_on_container_copy_assignment::value) {
+    if constexpr (AllocatorTraits::propagate_on_container_copy_assignment::value) {
+      HashTable copy(other, other.t_alloc);
+      clear_list_elements();
       t_alloc = other.t_alloc;
+      swap_and_kill(std::move(copy));
+    } else {
+      swap_and_kill(HashTable(other, t_alloc));
     }
-    swap_and_kill(std::move(copy));
     return *this;
   }
 
-  UnorderedMap& operator=(UnorderedMap&& other) noexcept {
+  // Pairs allocated by an unequal, non-propagating allocator cannot be
+  // adopted, so they are moved over one by one; that path allocates and may
+  // throw. A const key cannot be moved out of its pair, so such allocators
+  // need copyable keys (values only have to be movable).
+  HashTable& operator=(HashTable&& other) noexcept(
+      AllocatorTraits::propagate_on_container_move_assignment::value ||
+      AllocatorTraits::is_always_equal::value) {
     if (this == &other) {
       return *this;
     }
-    if (std::allocator_traits<Allocator>::propagate_on_container_move_assignment::value) {
+    if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value) {
+      clear_list_elements();
       t_alloc = std::move(other.t_alloc);
+      swap_and_kill(std::move(other));
+    } else if constexpr (AllocatorTraits::is_always_equal::value) {
+      swap_and_kill(std::move(other));
+    } else {
+      static_assert(std::is_constructible_v<NodeType, NodeType&&>,
+                    "move assignment with unequal allocators copies keys");
+      if (t_alloc == other.t_alloc) {
+        swap_and_kill(std::move(other));
+        return *this;
+      }
+      clear();
+      hash_function = other.hash_function;
+      equal_key = other.equal_key;
+      current_max_load_factor = other.current_max_load_factor;
+      current_max_chain_length = other.current_max_chain_length;
+      reserve(other.size());
+      for (NodeType& item : other) {
+        insert(std::move(item));
+      }
+      other.clear();
     }
-    swap_and_kill(std::move(other));
     return *this;
   }
 
-  ~UnorderedMap() {
+  ~HashTable() {
     clear_list_elements();
   }
 
@@ -480,8 +881,36 @@ public:
     return elements.size();
   }
 
+  static const Key& key_of(const NodeType& node) {
+    return KeyOf()(node);
+  }
+
   size_t get_hash(const Key& key) const {
-    return hash_function(key) % hash_array.size();
+    return GrowthPolicy::index(hash_function(key), hash_array.size());
+  }
+
+  size_t bucket_count() const {
+    return hash_array.size();
+  }
+
+  size_t capacity_for(size_t buckets) const {
+    return static_cast<size_t>(static_cast<double>(buckets) * current_max_load_factor);
+  }
+
+  // Number of elements the map holds before the next insert rehashes.
+  size_t capacity() const {
+    return capacity_for(hash_array.size());
+  }
+
+  // Smallest bucket count allowed by the policy whose capacity is `count`.
+  size_t bucket_count_for(size_t count) const {
+    size_t buckets = GrowthPolicy::bucket_count(std::max<size_t>(
+        static_cast<size_t>(static_cast<double>(count) / current_max_load_factor), 1
+    ));
+    while (capacity_for(buckets) < count) {
+      buckets = GrowthPolicy::bucket_count(buckets + 1);
+    }
+    return buckets;
   }
 
   float load_factor() const {
@@ -500,85 +929,169 @@ public:
     return current_max_load_factor;
   }
 
-  void update() {
-    if (load_factor_after_insert() > current_max_load_factor) {
-      reserve(hash_array.size() * 2 + 1);
+  void max_chain_length(size_t value) {
+    current_max_chain_length = value;
+  }
+
+  size_t max_chain_length() const {
+    return current_max_chain_length;
+  }
+
+  // True if the hash function was reseeded, which invalidates every hash
+  // the caller computed before.
+  bool update(size_t chain = 0) {
+    if (elements.size() + 1 > capacity()) {
+      rehash(std::max(
+          GrowthPolicy::next(hash_array.size()), bucket_count_for(elements.size() + 1)
+      ));
+    } else if (chain >= current_max_chain_length) {
+      return reseed();
+    }
+    return false;
+  }
+
+  // Only seeded hashes can escape a flooded bucket; the size gate keeps keys
+  // that collide under every seed from triggering a rehash on each insert.
+  bool reseed() {
+    if constexpr (has_reseed<Hash>::value) {
+      if (elements.size() < next_reseed_size) {
+        return false;
+      }
+      hash_function.reseed();
+      rehash(hash_array.size());
+      next_reseed_size = elements.size() * 2;
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  // Clears the stale bits erased keys left behind without touching buckets.
+  void rebuild_filter() {
+    filter.reset(capacity());
+    for (ListIterator it = elements.begin(); it != elements.end(); ++it) {
+      filter.add(hash_function(key_of(**it)));
     }
   }
 
+  // Afterwards `count` elements fit without another rehash.
   void reserve(size_t count) {
-    if (count > hash_array.size()) {
-      rehash(static_cast<size_t>(static_cast<float>(count) / max_load_factor() + 1));
+    if (count > capacity()) {
+      rehash(bucket_count_for(count));
     }
   }
 
+  // Rounds `count` through the growth policy; never shrinks below the
+  // bucket count the current size needs.
   void rehash(size_t count) {
-    hash_array.clear();
-    List<NodeType*> copy = std::move(elements);
-    hash_array.resize(count, elements.end());
-    for (ListIterator it = copy.begin(); it != copy.end(); ++it) {
-      ListIterator& elem = hash_array[get_hash((*it)->first)];
-      if (elem == elements.end()) {
-        elem = elements.insert(elements.cend(), *it);
-      } else {
-        elem = elements.insert(elem, *it);
-      }
+    count = std::max(GrowthPolicy::bucket_count(std::max<size_t>(count, 1)),
+                     bucket_count_for(elements.size()));
+    // Everything that allocates happens before the table is touched; the
+    // rest only relinks list nodes, so a bad_alloc leaves it as it was.
+    ElementList pending(t_alloc);
+    BucketArray buckets(count, pending.end(), hash_array.get_allocator());
+    filter.reset(capacity_for(count));
+    pending.no_allocator_swap(elements);
+    hash_array.swap(buckets);
+    while (pending.begin() != pending.end()) {
+      ListIterator it = pending.begin();
+      size_t full_hash = hash_function(key_of(**it));
+      filter.add(full_hash);
+      ListIterator& elem = hash_array[GrowthPolicy::index(full_hash, count)];
+      elem = elements.splice(elem, pending, it);
+    }
+  }
+
+  // Bucket for a key about to be linked, after update() has grown the table
+  // if needed. The probe's hash is reused unless a reseed replaced it.
+  size_t prepare_link(const Key& key, size_t full_hash, size_t chain) {
+    if (update(chain)) {
+      full_hash = hash_function(key);
+    }
+    if (filter.saturated()) {
+      rebuild_filter();
     }
+    filter.add(full_hash);
+    return GrowthPolicy::index(full_hash, hash_array.size());
+  }
+
+  // Links `node` at the head of `bucket`, as returned by prepare_link().
+  iterator link(size_t bucket, NodeType* node) {
+    ListIterator& elem = hash_array[bucket];
+    if (elem == elements.end()) {
+      elem = elements.insert(elements.cend(), node);
+    } else {
+      elem = elements.insert(elem, node);
+    }
+    return elem;
   }
 
   template<class... Args>
   std::pair<iterator, bool> emplace(Args&&... args) {
-    NodeType* mover = std::allocator_traits<Allocator>::allocate(t_alloc, 1);
-    std::allocator_traits<Allocator>::construct(t_alloc, mover, std::forward<Args>(args)...);
-    iterator result = find(mover->first);
+    NodeType* mover = AllocatorTraits::allocate(t_alloc, 1);
+    AllocatorTraits::construct(t_alloc, mover, std::forward<Args>(args)...);
+    auto result = adopt(mover);
+    if (!result.second) {
+      AllocatorTraits::destroy(t_alloc, mover);
+      AllocatorTraits::deallocate(t_alloc, mover, 1);
+    }
+    return result;
+  }
+
+  // Links a pair allocated through get_allocator(). The map owns it unless
+  // the key is already present, in which case the caller keeps it.
+  std::pair<iterator, bool> adopt(NodeType* node) {
+    size_t full_hash = hash_function(key_of(*node));
+    size_t chain = 0;
+    iterator result = find_in_bucket(
+        key_of(*node), GrowthPolicy::index(full_hash, hash_array.size()), chain
+    );
     if (result != elements.end()) {
-      std::allocator_traits<Allocator>::destroy(t_alloc, mover);
-      std::allocator_traits<Allocator>::deallocate(t_alloc, mover, 1);
       return {result, false};
     }
-    update();
-    ListIterator& elem = hash_array[get_hash(mover->first)];
-    if (elem ==  elements.end()) {
-      elements.insert(elements.cend(), mover);
-    } else {
-      elements.insert(elem, mover);
+    return {link(prepare_link(key_of(*node), full_hash, chain), node), true};
+  }
+
+  // Hands every pair to `sink` and empties the map without destroying them.
+  template<typename Sink>
+  void release(Sink&& sink) {
+    for (iterator it = elements.begin(); it != elements.end(); ++it) {
+      sink(&*it);
     }
-    return {elem, true};
+    elements.clear();
+    hash_array.assign(hash_array.size(), elements.end());
+    filter.reset(capacity());
   }
 
   std::pair<iterator, bool> insert(const NodeType& value) {
-    iterator result = find(value.first);
+    size_t full_hash = hash_function(KeyOf()(value));
+    size_t chain = 0;
+    iterator result = find_in_bucket(
+        KeyOf()(value), GrowthPolicy::index(full_hash, hash_array.size()), chain
+    );
     if (result != elements.end()) {
       return {result, false};
     }
-    update();
-    ListIterator& elem = hash_array[get_hash(value.first)];
-    NodeType* copy = std::allocator_traits<Allocator>::allocate(t_alloc, 1);
-    std::allocator_traits<Allocator>::construct(t_alloc, copy, value);
-    if (elem == elements.end()) {
-      elem = elements.insert(elements.end(), copy);
-    } else {
-      elem = elements.insert(elem, copy);
-    }
-    return {elem, true};
+    size_t bucket = prepare_link(KeyOf()(value), full_hash, chain);
+    NodeType* copy = AllocatorTraits::allocate(t_alloc, 1);
+    AllocatorTraits::construct(t_alloc, copy, value);
+    return {link(bucket, copy), true};
   }
 
   template<typename NodePair>
   std::pair<iterator, bool> insert(NodePair&& value) {
-    iterator result = find(value.first);
+    size_t full_hash = hash_function(KeyOf()(value));
+    size_t chain = 0;
+    iterator result = find_in_bucket(
+        KeyOf()(value), GrowthPolicy::index(full_hash, hash_array.size()), chain
+    );
     if (result != iterator(elements.end())) {
       return {result, false};
     }
-    update();
-    ListIterator& elem = hash_array[get_hash(value.first)];
-    NodeType* mover = std::allocator_traits<Allocator>::allocate(t_alloc, 1);
-    std::allocator_traits<Allocator>::construct(t_alloc, mover, std::forward<NodePair>(value));
-    if (elem ==  elements.end()) {
-      elem = elements.insert(elements.end(), mover);
-    } else {
-      elem = elements.insert(elem, mover);
-    }
-    return {elem, true};
+    size_t bucket = prepare_link(KeyOf()(value), full_hash, chain);
+    NodeType* mover = AllocatorTraits::allocate(t_alloc, 1);
+    AllocatorTraits::construct(t_alloc, mover, std::forward<NodePair>(value));
+    return {link(bucket, mover), true};
   }
 
   template<typename Input>
@@ -596,14 +1109,17 @@ public:
   }
 
   iterator erase(const_iterator it) {
-    size_t hash = get_hash(it->first);
-    if (const_iterator(hash_array[hash]) != it) {
-      return elements.erase(it.it);
+    NodeType* node = *it.it;
+    size_t hash = get_hash(key_of(*node));
+    bool bucket_head = const_iterator(hash_array[hash]) == it;
+    ListIterator nit = elements.erase(it.it);
+    if (bucket_head) {
+      hash_array[hash] = (
+          nit != elements.end() && get_hash(key_of(**nit)) == hash ? nit : elements.end()
+      );
     }
-    auto nit = elements.erase(it.it);
-    hash_array[hash] = (
-        nit != elements.end() && get_hash((*nit)->first) == hash ? nit : elements.end()
-    );
+    AllocatorTraits::destroy(t_alloc, node);
+    AllocatorTraits::deallocate(t_alloc, node, 1);
     return nit;
   }
 
@@ -618,38 +1134,121 @@ public:
     return end();
   }
 
+  // Misses the filter rules out cost one hash and one filter probe.
   iterator find(const Key& key) {
-    size_t hash = get_hash(key);
+    size_t full_hash = hash_function(key);
+    if (!filter.may_contain(full_hash)) {
+      return elements.end();
+    }
+    size_t chain = 0;
+    return find_in_bucket(key, GrowthPolicy::index(full_hash, hash_array.size()), chain);
+  }
+
+  const_iterator find(const Key& key) const {
+    size_t full_hash = hash_function(key);
+    if (!filter.may_contain(full_hash)) {
+      return elements.cend();
+    }
+    size_t chain = 0;
+    return find_in_bucket(key, GrowthPolicy::index(full_hash, hash_array.size()), chain);
+  }
+
+  bool contains(const Key& key) const {
+    return find(key) != end();
+  }
+
+  // Splits the map into `count` disjoint ranges of consecutive buckets.
+  // Ranges hold equally many buckets, so with a well-spread hash they hold
+  // roughly equally many elements; splitting costs O(count), not a scan.
+  // Walking a range costs one hash per element on top of the visit: nodes
+  // carry no hash, so a bucket's end is found by hashing the next key. For
+  // expensive hashes (SipHash over long strings) that can rival a cheap fn.
+  // Valid until the next insert or rehash.
+  std::vector<bucket_range<false>> partition(size_t count) {
+    return partition_impl<false>(count);
+  }
+
+  std::vector<bucket_range<true>> partition(size_t count) const {
+    return partition_impl<true>(count);
+  }
+
+  template<bool IsConst>
+  std::vector<bucket_range<IsConst>> partition_impl(size_t count) const {
+    auto self = const_cast<HashTable*>(this);
+    count = std::clamp<size_t>(count, 1, hash_array.size());
+    std::vector<bucket_range<IsConst>> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      size_t first = hash_array.size() * i / count;
+      size_t last = hash_array.size() * (i + 1) / count;
+      result.push_back({{self, first, last}, {self, last, last}});
+    }
+    return result;
+  }
+
+  // Calls fn on every element, one partition per thread; the calling thread
+  // takes the first. fn may run concurrently on different elements but must
+  // not insert or erase. The first exception thrown is rethrown after join.
+  // If a thread cannot be started, the calling thread runs the partitions
+  // that were left without one.
+  template<typename Fn>
+  void parallel_for_each(Fn fn, size_t threads = std::thread::hardware_concurrency()) {
+    auto ranges = partition(std::max<size_t>(threads, 1));
+    std::vector<std::exception_ptr> errors(ranges.size());
+    auto work = [&](size_t index) {
+      try {
+        for (NodeType& item : ranges[index]) {
+          fn(item);
+        }
+      } catch (...) {
+        errors[index] = std::current_exception();
+      }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(ranges.size() - 1);
+    size_t spawned = 1;
+    try {
+      for (; spawned < ranges.size(); ++spawned) {
+        workers.emplace_back(work, spawned);
+      }
+    } catch (...) {
+    }
+    work(0);
+    for (size_t i = spawned; i < ranges.size(); ++i) {
+      work(i);
+    }
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+    for (std::exception_ptr& error : errors) {
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+  }
+
+  iterator find_in_bucket(const Key& key, size_t hash, size_t& chain) {
     iterator it = hash_array[hash];
-    //iterator it(elements.begin());
-    while (it != elements.end() && get_hash(it->first) == hash) {
-      if (equal_key(it->first, key)) {
+    while (it != elements.end() && get_hash(key_of(*it)) == hash) {
+      if (equal_key(key_of(*it), key)) {
         return it;
       }
       ++it;
+      ++chain;
     }
     return elements.end();
   }
 
-  Value& at(const Key& key) {
-    size_t hash = get_hash(key);
-    ListIterator it = hash_array[hash];
-    while (it != elements.end() && get_hash((*it)->first) == hash) {
-      if (equal_key((*it)->first, key)) {
-        return (*it)->second;
+  const_iterator find_in_bucket(const Key& key, size_t hash, size_t& chain) const {
+    const_iterator it = iterator(hash_array[hash]);
+    while (it != elements.cend() && get_hash(key_of(*it)) == hash) {
+      if (equal_key(key_of(*it), key)) {
+        return it;
       }
       ++it;
+      ++chain;
     }
-    throw std::out_of_range("Target element doesn't exists");
-  }
-
-  Value& operator[](const Key& key) {
-    try {
-      return at(key);
-    } catch(std::out_of_range&) {
-      iterator it = insert({key, Value()}).first;
-      return it->second;
-    }
+    return elements.cend();
   }
 
   iterator begin() {
@@ -675,4 +1274,68 @@ public:
   const_iterator cend() const {
     return elements.cend();
   }
-};
\ No newline at end of file
+};
+
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>,
+    typename Allocator = std::allocator<std::pair<const Key, Value>>,
+    typename GrowthPolicy = DefaultGrowthPolicy,
+    typename Filter = NoFilter
+>
+class UnorderedMap: public HashTable<
+    Key, std::pair<const Key, Value>, PairKey, Hash, Equal, Allocator, GrowthPolicy, Filter
+> {
+  using Base = HashTable<
+      Key, std::pair<const Key, Value>, PairKey, Hash, Equal, Allocator, GrowthPolicy, Filter
+  >;
+public:
+  using Base::Base;
+  using typename Base::iterator;
+  using typename Base::ListIterator;
+
+  Value& at(const Key& key) {
+    size_t full_hash = this->hash_function(key);
+    if (!this->filter.may_contain(full_hash)) {
+      throw std::out_of_range("Target element doesn't exists");
+    }
+    size_t hash = GrowthPolicy::index(full_hash, this->hash_array.size());
+    ListIterator it = this->hash_array[hash];
+    while (it != this->elements.end() && this->get_hash((*it)->first) == hash) {
+      if (this->equal_key((*it)->first, key)) {
+        return (*it)->second;
+      }
+      ++it;
+    }
+    throw std::out_of_range("Target element doesn't exists");
+  }
+
+  Value& operator[](const Key& key) {
+    try {
+      return at(key);
+    } catch(std::out_of_range&) {
+      iterator it = this->insert({key, Value()}).first;
+      return it->second;
+    }
+  }
+};
+
+namespace pmr {
+
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>,
+    typename GrowthPolicy = DefaultGrowthPolicy,
+    typename Filter = NoFilter
+>
+using UnorderedMap = ::UnorderedMap<
+    Key, Value, Hash, Equal,
+    std::pmr::polymorphic_allocator<std::pair<const Key, Value>>,
+    GrowthPolicy, Filter
+>;
+
+}  // namespace pmr
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <iterator>
+#include "unordered_map.h"
+
+
+// Equal keys are linked next to each other inside their bucket run, so
+// equal_range() is one hash plus a walk over the matching nodes. Rehashing
+// keeps runs contiguous because it relinks elements in list order.
+template<
+    typename Key,
+    typename Value,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>,
+    typename Allocator = std::allocator<std::pair<const Key, Value>>,
+    typename GrowthPolicy = DefaultGrowthPolicy
+>
+class UnorderedMultiMap: private UnorderedMap<Key, Value, Hash, Equal, Allocator, GrowthPolicy> {
+  using Base = UnorderedMap<Key, Value, Hash, Equal, Allocator, GrowthPolicy>;
+public:
+  using typename Base::NodeType;
+  using typename Base::AllocatorTraits;
+  using typename Base::ListIterator;
+  using typename Base::iterator;
+  using typename Base::const_iterator;
+
+  using Base::size;
+  using Base::load_factor;
+  using Base::max_load_factor;
+  using Base::max_chain_length;
+  using Base::bucket_count;
+  using Base::capacity;
+  using Base::reserve;
+  using Base::rehash;
+  using Base::clear;
+  using Base::get_allocator;
+  using Base::find;
+  using Base::erase;
+  using Base::begin;
+  using Base::end;
+  using Base::cbegin;
+  using Base::cend;
+
+  UnorderedMultiMap() = default;
+
+  explicit UnorderedMultiMap(const Allocator& alloc): Base(alloc) {}
+
+  UnorderedMultiMap(const UnorderedMultiMap& other):
+      Base(1, other.hash_function, other.equal_key,
+           AllocatorTraits::select_on_container_copy_construction(other.t_alloc)) {
+    this->max_load_factor(other.current_max_load_factor);
+    this->rehash(other.hash_array.size());
+    for (const NodeType& item : other) {
+      emplace(item);
+    }
+  }
+
+  UnorderedMultiMap(UnorderedMultiMap&& other) = default;
+
+  UnorderedMultiMap& operator=(const UnorderedMultiMap& other) {
+    if (this != &other) {
+      *this = UnorderedMultiMap(other);
+    }
+    return *this;
+  }
+
+  UnorderedMultiMap& operator=(UnorderedMultiMap&& other) noexcept(
+      AllocatorTraits::propagate_on_container_move_assignment::value ||
+      AllocatorTraits::is_always_equal::value) {
+    if constexpr (AllocatorTraits::propagate_on_container_move_assignment::value ||
+        AllocatorTraits::is_always_equal::value) {
+      Base::operator=(std::move(other));
+    } else {
+      static_assert(std::is_constructible_v<NodeType, NodeType&&>,
+                    "move assignment with unequal allocators copies keys");
+      if (this == &other) {
+        return *this;
+      }
+      if (this->t_alloc == other.t_alloc) {
+        Base::operator=(std::move(other));
+        return *this;
+      }
+      clear();
+      for (NodeType& item : other) {
+        emplace(std::move(item));
+      }
+      other.clear();
+    }
+    return *this;
+  }
+
+  // Links a constructed node in front of the run of keys equal to it, or at
+  // the head of its bucket when the key is new.
+  iterator link(NodeType* node) {
+    size_t hash = this->get_hash(node->first);
+    size_t chain = 0;
+    iterator run = this->find_in_bucket(node->first, hash, chain);
+    if (chain >= this->current_max_chain_length) {
+      this->reseed();
+      hash = this->get_hash(node->first);
+      run = this->find_in_bucket(node->first, hash, chain);
+    }
+    return link_before(run, hash, node);
+  }
+
+  iterator link_before(iterator run, size_t hash, NodeType* node) {
+    ListIterator& head = this->hash_array[hash];
+    ListIterator anchor = run != end() ? run.it : head;
+    ListIterator position = this->elements.insert(anchor, node);
+    if (head == this->elements.end() || head == anchor) {
+      head = position;
+    }
+    return position;
+  }
+
+  template<typename... Args>
+  iterator emplace(Args&&... args) {
+    NodeType* node = AllocatorTraits::allocate(this->t_alloc, 1);
+    AllocatorTraits::construct(this->t_alloc, node, std::forward<Args>(args)...);
+    this->update();
+    return link(node);
+  }
+
+  iterator insert(const NodeType& value) {
+    return emplace(value);
+  }
+
+  iterator insert(NodeType&& value) {
+    return emplace(std::move(value));
+  }
+
+  template<typename Input>
+  void insert(Input first, Input last) {
+    for (; first != last; emplace(*first++));
+  }
+
+  // Adds every value in [first, last) under one key, hashing the key once.
+  template<typename Input>
+  iterator insert(const Key& key, Input first, Input last) {
+    if (first == last) {
+      return end();
+    }
+    reserve(size() + std::distance(first, last));
+    size_t hash = this->get_hash(key);
+    size_t chain = 0;
+    iterator run = this->find_in_bucket(key, hash, chain);
+    iterator result = end();
+    for (; first != last; ++first) {
+      NodeType* node = AllocatorTraits::allocate(this->t_alloc, 1);
+      AllocatorTraits::construct(this->t_alloc, node, key, *first);
+      iterator position = link_before(run, hash, node);
+      if (result == end()) {
+        result = position;
+        if (run == end()) {
+          run = position;
+        }
+      }
+    }
+    return result;
+  }
+
+  std::pair<iterator, iterator> equal_range(const Key& key) {
+    iterator first = find(key);
+    iterator last = first;
+    while (last != end() && this->equal_key(last->first, key)) {
+      ++last;
+    }
+    return {first, last};
+  }
+
+  size_t count(const Key& key) {
+    auto range = equal_range(key);
+    return std::distance(range.first, range.second);
+  }
+
+  size_t erase(const Key& key) {
+    auto range = equal_range(key);
+    size_t result = std::distance(range.first, range.second);
+    if (result > 0) {
+      Base::erase(range.first, range.second);
+    }
+    return result;
+  }
+};
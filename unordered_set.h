@@ -0,0 +1,189 @@
+#pragma once
+
+#include <iterator>
+#include <type_traits>
+#include "unordered_map.h"
+
+
+// Key-only counterpart of UnorderedMap on the same bucket/list engine: each
+// element allocates a bare Key instead of a std::pair<const Key, Value>.
+// Keys are reachable through const iterators only.
+template<
+    typename Key,
+    typename Hash = DefaultHash<Key>,
+    typename Equal = std::equal_to<Key>,
+    typename Allocator = std::allocator<Key>,
+    typename GrowthPolicy = DefaultGrowthPolicy
+>
+class UnorderedSet: private HashTable<Key, Key, IdentityKey, Hash, Equal, Allocator, GrowthPolicy> {
+  using Base = HashTable<Key, Key, IdentityKey, Hash, Equal, Allocator, GrowthPolicy>;
+public:
+  using typename Base::NodeType;
+  using typename Base::AllocatorTraits;
+  using typename Base::ListIterator;
+  using iterator = typename Base::const_iterator;
+  using const_iterator = typename Base::const_iterator;
+
+  using Base::Base;
+  using Base::size;
+  using Base::load_factor;
+  using Base::max_load_factor;
+  using Base::max_chain_length;
+  using Base::bucket_count;
+  using Base::capacity;
+  using Base::reserve;
+  using Base::rehash;
+  using Base::clear;
+  using Base::get_allocator;
+
+  template<typename Input, typename = typename std::iterator_traits<Input>::iterator_category>
+  UnorderedSet(Input first, Input last) {
+    insert(first, last);
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  template<typename... Args>
+  std::pair<const_iterator, bool> emplace(Args&&... args) {
+    return Base::emplace(std::forward<Args>(args)...);
+  }
+
+  std::pair<const_iterator, bool> insert(const Key& key) {
+    return Base::insert(key);
+  }
+
+  std::pair<const_iterator, bool> insert(Key&& key) {
+    return Base::insert(std::move(key));
+  }
+
+  // Reserves once for forward ranges, so a bulk load rehashes at most once.
+  template<typename Input>
+  void insert(Input first, Input last) {
+    using Category = typename std::iterator_traits<Input>::iterator_category;
+    if constexpr (std::is_base_of_v<std::forward_iterator_tag, Category>) {
+      reserve(size() + std::distance(first, last));
+    }
+    for (; first != last; insert(*first++));
+  }
+
+  const_iterator find(const Key& key) const {
+    return Base::find(key);
+  }
+
+  bool contains(const Key& key) const {
+    return find(key) != end();
+  }
+
+  size_t count(const Key& key) const {
+    return contains(key) ? 1 : 0;
+  }
+
+  // Batch membership test: writes one bool per key of [first, last).
+  template<typename Input, typename Output>
+  Output contains(Input first, Input last, Output out) const {
+    for (; first != last; ++first) {
+      *out++ = contains(*first);
+    }
+    return out;
+  }
+
+  size_t erase(const Key& key) {
+    return Base::erase(key);
+  }
+
+  const_iterator erase(const_iterator it) {
+    return Base::erase(it);
+  }
+
+  const_iterator erase(const_iterator first, const_iterator last) {
+    return Base::erase(first, last);
+  }
+
+  // Erases every key of [first, last); returns how many were present.
+  template<typename Input>
+  size_t erase_keys(Input first, Input last) {
+    size_t result = 0;
+    for (; first != last; result += erase(*first++));
+    return result;
+  }
+
+  // With a stateless Hash and equal bucket counts a key lands in the same
+  // bucket of both sets, so one bucket index serves both of them.
+  bool shares_buckets(const UnorderedSet& other) const {
+    return std::is_empty_v<Hash> && bucket_count() == other.bucket_count();
+  }
+
+  // Links a copy of `key` into bucket `hash` unless it is already there.
+  // Skips update(): callers reserve room for every key first, so neither a
+  // rehash nor a reseed can be due. Valid only because sets use NoFilter;
+  // the key is not added to any lookup filter.
+  void insert_in_bucket(const Key& key, size_t hash) {
+    size_t chain = 0;
+    if (this->find_in_bucket(key, hash, chain) != Base::end()) {
+      return;
+    }
+    NodeType* node = AllocatorTraits::allocate(this->t_alloc, 1);
+    AllocatorTraits::construct(this->t_alloc, node, key);
+    ListIterator& head = this->hash_array[hash];
+    head = this->elements.insert(head, node);
+  }
+
+  // Adds every key of `other`. The table is grown once up front and each
+  // incoming key is hashed once for both the probe and the link.
+  void merge(const UnorderedSet& other) {
+    reserve(size() + other.size());
+    for (const Key& key : other) {
+      insert_in_bucket(key, this->get_hash(key));
+    }
+  }
+
+  // Keys present in both sets. The smaller set is scanned; when the sets
+  // share buckets its key's bucket index is reused to probe the larger set
+  // and to link into the result, which is created with the same bucket
+  // count and max load factor, so every key is hashed exactly once. If that
+  // capacity cannot hold the smaller set, the result reserves and rehashes
+  // keys instead.
+  UnorderedSet intersection(const UnorderedSet& other) const {
+    const UnorderedSet& small = size() <= other.size() ? *this : other;
+    const UnorderedSet& large = size() <= other.size() ? other : *this;
+    UnorderedSet result(
+        large.bucket_count(), this->hash_function, this->equal_key,
+        AllocatorTraits::select_on_container_copy_construction(this->t_alloc)
+    );
+    result.max_load_factor(large.current_max_load_factor);
+    bool shared = small.shares_buckets(large) && result.capacity() >= small.size();
+    if (!shared) {
+      result.reserve(small.size());
+    }
+    for (const Key& key : small) {
+      size_t hash = large.get_hash(key);
+      size_t chain = 0;
+      if (large.find_in_bucket(key, hash, chain) != large.end()) {
+        if (shared) {
+          result.insert_in_bucket(key, hash);
+        } else {
+          result.insert(key);
+        }
+      }
+    }
+    return result;
+  }
+
+  const_iterator begin() const {
+    return Base::cbegin();
+  }
+
+  const_iterator end() const {
+    return Base::cend();
+  }
+
+  const_iterator cbegin() const {
+    return Base::cbegin();
+  }
+
+  const_iterator cend() const {
+    return Base::cend();
+  }
+};